@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "batch.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to read a manifest of TREXIO files
+// Parameters:
+// - manifest: Text file with one input path per line
+// - inputs: List of inputs, reallocated to hold the new entries
+// - n_inputs: Number of inputs already in the list
+int batch_read_manifest(const char* manifest, char*** inputs, int n_inputs)
+{
+    FILE* file = fopen(manifest, "r");
+    if (file == NULL) return -1;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        // Strip surrounding blanks and the end of line
+        char* path = line;
+        while (*path == ' ' || *path == '\t') path++;
+        size_t length = strcspn(path, "\r\n");
+        while (length > 0 && (path[length - 1] == ' ' || path[length - 1] == '\t')) length--;
+        path[length] = '\0';
+
+        if (length == 0 || path[0] == '#') continue;
+
+        char** grown = realloc(*inputs, (n_inputs + 1) * sizeof(char*));
+        if (grown == NULL)
+        {
+            fclose(file);
+            return -1;
+        }
+        *inputs = grown;
+        (*inputs)[n_inputs] = strdup(path);
+        if ((*inputs)[n_inputs] == NULL)
+        {
+            fclose(file);
+            return -1;
+        }
+        n_inputs++;
+    }
+
+    fclose(file);
+    return n_inputs;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// State shared by the workers of a batch
+typedef struct
+{
+    char** inputs;
+    int n_inputs;
+    int next;                   // Next input to hand out
+    pthread_mutex_t lock;       // Protects next
+    const mp2_options_t* options;
+    mp2_result_t* results;
+} batch_t;
+
+// Worker: takes the next unprocessed input until the list is exhausted
+// A worker without a context reports the inputs it takes as failed.
+static void* batch_worker(void* arg)
+{
+    batch_t* batch = (batch_t*) arg;
+    mp2_context_t* context = mp2_context_create(batch->options);
+
+    while (1)
+    {
+        pthread_mutex_lock(&batch->lock);
+        int n = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (n >= batch->n_inputs) break;
+
+        mp2_result_t* result = &batch->results[n];
+        if (context == NULL)
+        {
+            memset(result, 0, sizeof(mp2_result_t));
+            result->input_filename = batch->inputs[n];
+            result->status = -1;
+            snprintf(result->message, sizeof(result->message), "Error: Memory allocation failed for the worker context.");
+            printf("%s: %s\n", result->input_filename, result->message);
+        }
+        else if (mp2_run_file(context, batch->inputs[n], result) == 0)
+            printf("%s: HF = %.6f, MP2 = %.6f (%.3f s%s) -> %s\n", result->input_filename,
+                   result->hf_energy, result->mp2_energy, result->wall_time,
+                   result->cached ? ", cached" : "", result->output_filename);
+        else
+            printf("%s: %s\n", result->input_filename, result->message);
+    }
+
+    mp2_context_free(context);
+    return NULL;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to process a list of TREXIO files with a bounded pool of workers
+// Parameters:
+// - inputs: TREXIO files
+// - n_inputs: Number of files
+// - n_workers: Number of worker threads (at most one per file)
+// - options: Loading options
+// - results: One result per input, in the order of the inputs
+int batch_run(char** inputs, int n_inputs, int n_workers, const mp2_options_t* options, mp2_result_t* results)
+{
+    batch_t batch;
+    batch.inputs = inputs;
+    batch.n_inputs = n_inputs;
+    batch.next = 0;
+    batch.options = options;
+    batch.results = results;
+    pthread_mutex_init(&batch.lock, NULL);
+
+    if (n_workers > n_inputs) n_workers = n_inputs;
+    if (n_workers < 1) n_workers = 1;
+
+    // A single worker runs on the calling thread
+    if (n_workers == 1)
+    {
+        batch_worker(&batch);
+    }
+    else
+    {
+        pthread_t* workers = malloc(n_workers * sizeof(pthread_t));
+        if (workers == NULL)
+        {
+            batch_worker(&batch);
+        }
+        else
+        {
+            for (int n = 0; n < n_workers; n++) pthread_create(&workers[n], NULL, batch_worker, &batch);
+            for (int n = 0; n < n_workers; n++) pthread_join(workers[n], NULL);
+            free(workers);
+        }
+    }
+
+    pthread_mutex_destroy(&batch.lock);
+
+    int n_failed = 0;
+    for (int n = 0; n < n_inputs; n++)
+    {
+        if (results[n].status != 0) n_failed++;
+    }
+    return n_failed;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write the machine-readable summary of a run
+// Parameters:
+// - summary_filename: Output file (".json" for JSON, CSV otherwise)
+// - results: Results of the run, in the order of the inputs
+// - n_results: Number of results
+int batch_write_summary(const char* summary_filename, const mp2_result_t* results, int n_results)
+{
+    FILE* file = fopen(summary_filename, "w");
+    if (file == NULL)
+    {
+        printf("Error: Unable to create summary file %s\n", summary_filename);
+        return -1;
+    }
+
+    const char* extension = strrchr(summary_filename, '.');
+    int json = (extension != NULL && strcmp(extension, ".json") == 0);
+
+    if (json)
+    {
+        fprintf(file, "[\n");
+        for (int n = 0; n < n_results; n++)
+        {
+            const mp2_result_t* r = &results[n];
+            fprintf(file, "  {\"input\": ");
+            write_json_string(file, r->input_filename);
+            fprintf(file, ", \"status\": \"%s\"", (r->status == 0) ? "ok" : "failed");
+            if (r->status == 0)
+            {
+                fprintf(file, ", \"report\": ");
+                write_json_string(file, r->output_filename);
+                fprintf(file, ", \"n_up\": %d, \"mo_num\": %d, \"n_integrals\": %lld", r->n_up, r->mo_num, (long long) r->n_integrals);
+                fprintf(file, ", \"nuclear_repulsion\": %.10f, \"hf_energy\": %.10f, \"mp2_energy\": %.10f, \"total_energy\": %.10f",
+                        r->nuclear_repulsion, r->hf_energy, r->mp2_energy, r->hf_energy + r->mp2_energy);
+                fprintf(file, ", \"n_frozen\": %d, \"mp2_same_spin\": %.10f, \"mp2_opposite_spin\": %.10f",
+                        r->n_frozen, r->mp2_same_spin, r->mp2_opposite_spin);
+                fprintf(file, ", \"wall_time\": %.6f, \"cached\": %s", r->wall_time, r->cached ? "true" : "false");
+                if (r->n_cholesky > 0) fprintf(file, ", \"cholesky_vectors\": %lld", (long long) r->n_cholesky);
+            }
+            else
+            {
+                fprintf(file, ", \"error\": ");
+                write_json_string(file, r->message);
+            }
+            fprintf(file, "}%s\n", (n + 1 < n_results) ? "," : "");
+        }
+        fprintf(file, "]\n");
+    }
+    else
+    {
+        fprintf(file, "input,status,n_up,mo_num,n_integrals,nuclear_repulsion,hf_energy,mp2_energy,total_energy,n_frozen,mp2_same_spin,mp2_opposite_spin,wall_time,cached,report\n");
+        for (int n = 0; n < n_results; n++)
+        {
+            const mp2_result_t* r = &results[n];
+            if (r->status == 0)
+                fprintf(file, "\"%s\",ok,%d,%d,%lld,%.10f,%.10f,%.10f,%.10f,%d,%.10f,%.10f,%.6f,%d,\"%s\"\n", r->input_filename,
+                        r->n_up, r->mo_num, (long long) r->n_integrals, r->nuclear_repulsion, r->hf_energy,
+                        r->mp2_energy, r->hf_energy + r->mp2_energy, r->n_frozen, r->mp2_same_spin,
+                        r->mp2_opposite_spin, r->wall_time, r->cached, r->output_filename);
+            else
+                fprintf(file, "\"%s\",failed,,,,,,,,,,,,,\n", r->input_filename);
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
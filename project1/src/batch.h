@@ -0,0 +1,19 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "mp2.h"
+
+// Function to append the TREXIO files listed in a manifest (one path per line,
+// blank lines and lines starting with '#' are skipped) to a list of inputs.
+// Returns the new number of inputs, or -1 if the manifest cannot be read.
+int batch_read_manifest(const char* manifest, char*** inputs, int n_inputs);
+
+// Function to process a list of TREXIO files with a pool of n_workers threads.
+// Every worker keeps its own context for all the molecules it handles.
+// results[n] receives the outcome of inputs[n]; returns the number of failures.
+int batch_run(char** inputs, int n_inputs, int n_workers, const mp2_options_t* options, mp2_result_t* results);
+
+// Function to write the summary of a run, as JSON if the name ends in ".json", as CSV otherwise
+int batch_write_summary(const char* summary_filename, const mp2_result_t* results, int n_results);
+
+#endif
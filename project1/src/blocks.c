@@ -0,0 +1,554 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "blocks.h"
+
+// Size of a transparent huge page
+#define BLOCKS_HUGE_PAGE (2 * 1024 * 1024)
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to allocate zeroed memory for an integral block
+// Blocks of a few huge pages or more are aligned on a huge page and the kernel is asked to back
+// them with huge pages, so that the scatter and the MP2 loop do not miss in the TLB at every
+// tile. Returns NULL if the allocation fails.
+static void* blocks_map(int64_t bytes)
+{
+    if (bytes <= 0) return NULL;
+
+    if (bytes < BLOCKS_HUGE_PAGE)
+    {
+        void* block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return (block == MAP_FAILED) ? NULL : block;
+    }
+
+    // Over-allocate by one huge page and give back the unaligned head and the tail
+    int64_t length = (bytes + BLOCKS_HUGE_PAGE - 1) / BLOCKS_HUGE_PAGE * BLOCKS_HUGE_PAGE;
+    char* map = mmap(NULL, length + BLOCKS_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) return NULL;
+
+    char* block = (char*) (((uintptr_t) map + BLOCKS_HUGE_PAGE - 1) & ~((uintptr_t) BLOCKS_HUGE_PAGE - 1));
+    if (block > map) munmap(map, block - map);
+    munmap(block + length, (map + BLOCKS_HUGE_PAGE) - block);
+
+#ifdef MADV_HUGEPAGE
+    madvise(block, length, MADV_HUGEPAGE);
+#endif
+    return block;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to release a block of the given size allocated by blocks_map
+static void blocks_unmap(void* block, int64_t bytes)
+{
+    if (block == NULL || bytes <= 0) return;
+    if (bytes >= BLOCKS_HUGE_PAGE) bytes = (bytes + BLOCKS_HUGE_PAGE - 1) / BLOCKS_HUGE_PAGE * BLOCKS_HUGE_PAGE;
+    munmap(block, bytes);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to allocate the (oo|oo) and (ov|ov) integral blocks
+// Parameters:
+// - n_up: Number of occupied orbitals
+// - mo_num: Total number of molecular orbitals
+// - n_frozen: Number of frozen core orbitals
+// - precision: Storage of the (ov|ov) block (BLOCKS_DOUBLE, BLOCKS_FLOAT or BLOCKS_MIXED)
+// - large_threshold: Magnitude of the integrals kept in double by BLOCKS_MIXED
+// - screening: Magnitude below which the (ov|ov) integrals are dropped (0 for a dense block)
+// - row_first, row_stride: Active rows of the (ov|ov) block kept (0 and 1 for all of them)
+// Returns NULL if the allocation fails.
+eri_blocks_t* blocks_alloc(int32_t n_up, int32_t mo_num, int32_t n_frozen, int32_t precision, double large_threshold,
+                           double screening, int32_t row_first, int32_t row_stride)
+{
+    // Integrals absent from the TREXIO file are zero
+    eri_blocks_t* blocks = calloc(1, sizeof(eri_blocks_t));
+    if (blocks == NULL) return NULL;
+    return blocks_reserve(blocks, n_up, mo_num, n_frozen, precision, large_threshold, screening, row_first, row_stride);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to release the slabs of a screened block
+static void blocks_free_slabs(eri_blocks_t* blocks)
+{
+    for (int64_t n = 0; n < blocks->n_slab; n++)
+    {
+        blocks_unmap(blocks->slab[n], blocks->slab_bytes);
+    }
+    blocks->n_slab = 0;
+    blocks->n_slab_used = 0;
+    blocks->slab_used = 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to free the integral blocks
+void blocks_free(eri_blocks_t* blocks)
+{
+    if (blocks == NULL) return;
+    blocks_unmap(blocks->oooo, blocks->capacity_oooo * sizeof(double));
+    blocks_unmap(blocks->oovv, blocks->capacity_oovv * sizeof(double));
+    blocks_unmap(blocks->oovv_float, blocks->capacity_oovv_float * sizeof(float));
+    free(blocks->large);
+    free(blocks->large_start);
+    free(blocks->bin);
+    free(blocks->bin_sorted);
+    free(blocks->bin_tile);
+    free(blocks->bin_start);
+    blocks_free_slabs(blocks);
+    free(blocks->slab);
+    free(blocks->tile);
+    free(blocks->tile_norm);
+    free(blocks);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to grow (or just clear) an index array so that it holds size elements of element_size bytes
+static int blocks_grow(void** block, int64_t* capacity, int64_t size, size_t element_size)
+{
+    if (size > *capacity)
+    {
+        free(*block);
+        *block = calloc(size, element_size);
+        *capacity = (*block == NULL) ? 0 : size;
+        return (*block == NULL) ? -1 : 0;
+    }
+
+    if (*block != NULL) memset(*block, 0, size * element_size);
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to grow (or just clear) one of the integral blocks, mapped with blocks_map
+static int blocks_grow_mapped(void** block, int64_t* capacity, int64_t size, size_t element_size)
+{
+    if (size > *capacity)
+    {
+        blocks_unmap(*block, *capacity * element_size);
+        *block = blocks_map(size * element_size);
+        *capacity = (*block == NULL) ? 0 : size;
+        return (*block == NULL) ? -1 : 0;
+    }
+
+    if (*block != NULL) memset(*block, 0, size * element_size);
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to decide whether the copies of the (ov|ov) block are binned by tile (MP2_SCATTER)
+// With the block on huge pages, the random writes of the direct scatter overlap well enough
+// that sorting them first did not pay off on the systems tried (see README.txt), so the
+// bins are only used on request.
+static int blocks_use_bins(void)
+{
+    const char* forced = getenv("MP2_SCATTER");
+    if (forced == NULL || strcmp(forced, "direct") == 0) return 0;
+    if (strcmp(forced, "binned") == 0) return 1;
+
+    printf("Warning: MP2_SCATTER=%s is unknown (direct or binned), using direct.\n", forced);
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to reuse the integral blocks for another molecule
+// The arrays are only reallocated when they are too small, otherwise they are just cleared.
+// Only the array of the chosen precision is used for the (ov|ov) block.
+// Parameters:
+// - blocks: Blocks of a previous molecule (or NULL)
+// - n_up: Number of occupied orbitals of the new molecule
+// - mo_num: Total number of molecular orbitals of the new molecule
+// - n_frozen: Number of frozen core orbitals
+// - precision: Storage of the (ov|ov) block (BLOCKS_DOUBLE, BLOCKS_FLOAT or BLOCKS_MIXED)
+// - large_threshold: Magnitude of the integrals kept in double by BLOCKS_MIXED
+// - screening: Magnitude below which the (ov|ov) integrals are dropped (0 for a dense block)
+// - row_first, row_stride: Active rows of the (ov|ov) block kept (0 and 1 for all of them)
+eri_blocks_t* blocks_reserve(eri_blocks_t* blocks, int32_t n_up, int32_t mo_num, int32_t n_frozen, int32_t precision,
+                             double large_threshold, double screening, int32_t row_first, int32_t row_stride)
+{
+    if (blocks == NULL)
+        return blocks_alloc(n_up, mo_num, n_frozen, precision, large_threshold, screening, row_first, row_stride);
+
+    if (row_stride < 1) row_stride = 1;
+    int64_t o = n_up;
+    int64_t a = n_up - n_frozen;
+    int64_t v = mo_num - n_up;
+    int64_t rows = (a > row_first) ? (a - row_first + row_stride - 1) / row_stride : 0;
+    int64_t n_tile = rows * a;
+    int screened = (screening > 0.0 && precision == BLOCKS_DOUBLE);
+    int64_t size_oovv = (precision == BLOCKS_DOUBLE && !screened) ? n_tile * v * v : 0;
+    int64_t size_float = (precision == BLOCKS_DOUBLE) ? 0 : n_tile * v * v;
+    int64_t size_start = (precision == BLOCKS_MIXED) ? n_tile + 1 : 0;
+    int binned = !screened && (n_tile * v * v > 0) && blocks_use_bins();
+
+    if (blocks_grow_mapped((void**) &blocks->oooo, &blocks->capacity_oooo, o * o * o * o, sizeof(double)) != 0 ||
+        blocks_grow_mapped((void**) &blocks->oovv, &blocks->capacity_oovv, size_oovv, sizeof(double)) != 0 ||
+        blocks_grow_mapped((void**) &blocks->oovv_float, &blocks->capacity_oovv_float, size_float, sizeof(float)) != 0 ||
+        blocks_grow((void**) &blocks->large_start, &blocks->capacity_large_start, size_start, sizeof(int64_t)) != 0 ||
+        blocks_grow((void**) &blocks->bin_start, &blocks->capacity_bin_start, binned ? n_tile + 1 : 0, sizeof(int64_t)) != 0 ||
+        blocks_grow((void**) &blocks->tile, &blocks->capacity_tile, screened ? n_tile : 0, sizeof(double*)) != 0 ||
+        blocks_grow((void**) &blocks->tile_norm, &blocks->capacity_tile_norm, screened ? n_tile : 0, sizeof(double)) != 0)
+    {
+        blocks_free(blocks);
+        return NULL;
+    }
+
+    // Slabs of a few tiles (a huge page), or of one tile rounded up to huge pages; they are
+    // handed out again to the next molecule when its tiles have the same size
+    int64_t tile_bytes = v * v * (int64_t) sizeof(double);
+    int64_t slab_bytes = (tile_bytes <= BLOCKS_SLAB_BYTES) ? BLOCKS_SLAB_BYTES :
+                         (tile_bytes + BLOCKS_SLAB_BYTES - 1) / BLOCKS_SLAB_BYTES * BLOCKS_SLAB_BYTES;
+    if (!screened || slab_bytes != blocks->slab_bytes) blocks_free_slabs(blocks);
+    blocks->slab_bytes = slab_bytes;
+    blocks->n_slab_used = 0;
+    blocks->slab_used = 0;
+    blocks->n_tile_kept = 0;
+
+    // The bins do not depend on the molecule and are kept once allocated
+    if (binned && blocks->bin == NULL)
+    {
+        blocks->bin = malloc(BLOCKS_BIN_SIZE * sizeof(blocks_entry_t));
+        blocks->bin_sorted = malloc(BLOCKS_BIN_SIZE * sizeof(blocks_entry_t));
+        blocks->bin_tile = malloc(BLOCKS_BIN_SIZE * sizeof(int32_t));
+        if (blocks->bin == NULL || blocks->bin_sorted == NULL || blocks->bin_tile == NULL)
+        {
+            blocks_free(blocks);
+            return NULL;
+        }
+    }
+
+    blocks->n_occ    = n_up;
+    blocks->n_virt   = mo_num - n_up;
+    blocks->n_frozen = n_frozen;
+    blocks->row_first = row_first;
+    blocks->row_stride = row_stride;
+    blocks->n_rows = (int32_t) rows;
+    blocks->precision = precision;
+    blocks->large_threshold = large_threshold;
+    blocks->screening = screened ? screening : 0.0;
+    blocks->n_large = 0;
+    if (blocks->capacity_large < 0) blocks->capacity_large = 0;
+    blocks->binned = binned;
+    blocks->n_bin = 0;
+    return blocks;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to keep a large integral of the mixed mode in double precision
+static void blocks_add_large(eri_blocks_t* blocks, int64_t offset, double value)
+{
+    if (blocks->capacity_large < 0) return;
+
+    if (blocks->n_large == blocks->capacity_large)
+    {
+        int64_t capacity = (blocks->capacity_large > 0) ? 2 * blocks->capacity_large : 4096;
+        blocks_entry_t* large = realloc(blocks->large, capacity * sizeof(blocks_entry_t));
+        if (large == NULL)
+        {
+            // Reported by blocks_finish, the chunks still go through
+            blocks->capacity_large = -1;
+            return;
+        }
+        blocks->large = large;
+        blocks->capacity_large = capacity;
+    }
+
+    blocks->large[blocks->n_large].offset = offset;
+    blocks->large[blocks->n_large].value = value;
+    blocks->n_large++;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write one element of the (ov|ov) block in its storage precision
+static inline void blocks_write_oovv(eri_blocks_t* blocks, int64_t offset, double value)
+{
+    if (blocks->precision == BLOCKS_DOUBLE)
+    {
+        blocks->oovv[offset] = value;
+        return;
+    }
+
+    blocks->oovv_float[offset] = (float) value;
+    if (blocks->precision == BLOCKS_MIXED && fabs(value) >= blocks->large_threshold)
+        blocks_add_large(blocks, offset, value);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to hand out a zeroed tile of a screened block, from the current slab or a new one
+// Returns NULL if a new slab could not be allocated.
+static double* blocks_new_tile(eri_blocks_t* blocks)
+{
+    int64_t tile_bytes = (int64_t) blocks->n_virt * blocks->n_virt * sizeof(double);
+    int64_t per_slab = blocks->slab_bytes / tile_bytes;
+
+    if (blocks->n_slab_used == 0 || blocks->slab_used == per_slab)
+    {
+        if (blocks->n_slab_used == blocks->n_slab)
+        {
+            if (blocks->n_slab == blocks->capacity_slab)
+            {
+                int64_t capacity = (blocks->capacity_slab > 0) ? 2 * blocks->capacity_slab : 64;
+                double** slab = realloc(blocks->slab, capacity * sizeof(double*));
+                if (slab == NULL) return NULL;
+                blocks->slab = slab;
+                blocks->capacity_slab = capacity;
+            }
+            blocks->slab[blocks->n_slab] = blocks_map(blocks->slab_bytes);
+            if (blocks->slab[blocks->n_slab] == NULL) return NULL;
+            blocks->n_slab++;
+        }
+        blocks->n_slab_used++;
+        blocks->slab_used = 0;
+    }
+
+    // The slabs of a previous molecule still hold its integrals
+    double* tile = (double*) ((char*) blocks->slab[blocks->n_slab_used - 1] + blocks->slab_used * tile_bytes);
+    blocks->slab_used++;
+    memset(tile, 0, tile_bytes);
+    return tile;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write one element of a screened (ov|ov) block, giving its tile memory if it has none yet
+static inline void blocks_write_screened(eri_blocks_t* blocks, int64_t tile, int64_t element, double value)
+{
+    if (blocks->tile[tile] == NULL)
+    {
+        // Reported by blocks_finish, the chunks still go through
+        if (blocks->n_tile_kept < 0) return;
+        blocks->tile[tile] = blocks_new_tile(blocks);
+        if (blocks->tile[tile] == NULL)
+        {
+            blocks->n_tile_kept = -1;
+            return;
+        }
+        blocks->n_tile_kept++;
+    }
+
+    blocks->tile[tile][element] = value;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write the waiting copies of the (ov|ov) block, one tile after the other
+// A counting sort on the tile puts the copies of each tile together, so that the writes
+// stay within one n_virt x n_virt tile (a few hundred kB) at a time.
+static void blocks_flush_bins(eri_blocks_t* blocks)
+{
+    int64_t n_tile = (int64_t) blocks->n_rows * (blocks->n_occ - blocks->n_frozen);
+    int64_t* start = blocks->bin_start;
+
+    memset(start, 0, (n_tile + 1) * sizeof(int64_t));
+    for (int64_t m = 0; m < blocks->n_bin; m++)
+    {
+        start[blocks->bin_tile[m] + 1]++;
+    }
+    for (int64_t t = 0; t < n_tile; t++)
+    {
+        start[t + 1] += start[t];
+    }
+    for (int64_t m = 0; m < blocks->n_bin; m++)
+    {
+        blocks->bin_sorted[start[blocks->bin_tile[m]]++] = blocks->bin[m];
+    }
+
+    for (int64_t m = 0; m < blocks->n_bin; m++)
+    {
+        blocks_write_oovv(blocks, blocks->bin_sorted[m].offset, blocks->bin_sorted[m].value);
+    }
+    blocks->n_bin = 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to store one permutation <pq|rs> if it falls in one of the kept blocks
+static inline void blocks_store(eri_blocks_t* blocks, int p, int q, int r, int s, double value)
+{
+    int64_t o = blocks->n_occ;
+    int64_t f = blocks->n_frozen;
+    int64_t v = blocks->n_virt;
+
+    // Both blocks have occupied bra indices
+    if (p >= o || q >= o) return;
+
+    if (r < o && s < o)
+    {
+        blocks->oooo[((p * o + q) * o + r) * o + s] = value;
+    }
+    else if (r >= o && s >= o && p >= f && q >= f)
+    {
+        // A distributed run keeps one row out of row_stride
+        int64_t row = p - f;
+        if (blocks->row_stride > 1)
+        {
+            if (row % blocks->row_stride != blocks->row_first) return;
+            row /= blocks->row_stride;
+        }
+
+        int64_t tile = row * (o - f) + (q - f);
+        if (blocks->screening > 0.0)
+        {
+            if (fabs(value) >= blocks->screening) blocks_write_screened(blocks, tile, (r - o) * v + (s - o), value);
+            return;
+        }
+
+        int64_t offset = (tile * v + (r - o)) * v + (s - o);
+        if (!blocks->binned)
+        {
+            blocks_write_oovv(blocks, offset, value);
+            return;
+        }
+
+        blocks->bin[blocks->n_bin].offset = offset;
+        blocks->bin[blocks->n_bin].value = value;
+        blocks->bin_tile[blocks->n_bin] = (int32_t) tile;
+        if (++blocks->n_bin == BLOCKS_BIN_SIZE) blocks_flush_bins(blocks);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Sink filtering a chunk of sparse integrals into the (oo|oo) and (ov|ov) blocks
+// Every unique integral is expanded over its 8 symmetric copies and only the
+// copies landing in a kept block are written; everything else is dropped.
+// For a binned block, the (ov|ov) copies are sorted by tile before being written.
+void blocks_sink(void* target, int64_t n, const int32_t* index, const double* value)
+{
+    eri_blocks_t* blocks = (eri_blocks_t*) target;
+    int o = blocks->n_occ;
+
+    for (int64_t m = 0; m < n; m++)
+    {
+        int i = index[4 * m + 0];
+        int j = index[4 * m + 1];
+        int k = index[4 * m + 2];
+        int l = index[4 * m + 3];
+
+        // Integrals with an odd number of occupied indices never reach a kept block
+        int n_occ = (i < o) + (j < o) + (k < o) + (l < o);
+        if (n_occ != 2 && n_occ != 4) continue;
+
+        double x = value[m];
+        blocks_store(blocks, i, j, k, l, x);
+        blocks_store(blocks, k, l, i, j, x);
+        blocks_store(blocks, k, j, i, l, x);
+        blocks_store(blocks, i, l, k, j, x);
+        blocks_store(blocks, j, i, l, k, x);
+        blocks_store(blocks, l, k, j, i, x);
+        blocks_store(blocks, j, k, l, i, x);
+        blocks_store(blocks, l, i, j, k, x);
+    }
+
+    if (blocks->n_bin > 0) blocks_flush_bins(blocks);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to order two large integrals by position
+static int blocks_compare_large(const void* a, const void* b)
+{
+    int64_t x = ((const blocks_entry_t*) a)->offset;
+    int64_t y = ((const blocks_entry_t*) b)->offset;
+    return (x > y) - (x < y);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to measure the Frobenius norm of every tile of a screened block
+static int blocks_finish_screened(eri_blocks_t* blocks)
+{
+    if (blocks->n_tile_kept < 0) return -1;
+
+    int64_t n_tile = (int64_t) blocks->n_rows * (blocks->n_occ - blocks->n_frozen);
+    int64_t tile_size = (int64_t) blocks->n_virt * blocks->n_virt;
+    for (int64_t tile = 0; tile < n_tile; tile++)
+    {
+        const double* x = blocks->tile[tile];
+        double sum = 0.0;
+        if (x != NULL)
+        {
+            for (int64_t n = 0; n < tile_size; n++) sum += x[n] * x[n];
+        }
+        blocks->tile_norm[tile] = sqrt(sum);
+    }
+
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to sort the large integrals of the mixed mode and index them by tile, or to measure
+// the tiles of a screened block
+// The symmetric copies landing on the same element are stored once.
+int blocks_finish(eri_blocks_t* blocks)
+{
+    if (blocks->screening > 0.0) return blocks_finish_screened(blocks);
+    if (blocks->precision != BLOCKS_MIXED) return 0;
+    if (blocks->capacity_large < 0) return -1;
+
+    qsort(blocks->large, blocks->n_large, sizeof(blocks_entry_t), blocks_compare_large);
+
+    int64_t n_unique = 0;
+    for (int64_t m = 0; m < blocks->n_large; m++)
+    {
+        if (n_unique > 0 && blocks->large[n_unique - 1].offset == blocks->large[m].offset) continue;
+        blocks->large[n_unique++] = blocks->large[m];
+    }
+    blocks->n_large = n_unique;
+
+    int64_t n_tile = (int64_t) blocks->n_rows * (blocks->n_occ - blocks->n_frozen);
+    int64_t tile_size = (int64_t) blocks->n_virt * blocks->n_virt;
+    int64_t m = 0;
+    for (int64_t tile = 0; tile <= n_tile; tile++)
+    {
+        while (m < n_unique && blocks->large[m].offset < tile * tile_size) m++;
+        blocks->large_start[tile] = m;
+    }
+
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to get the tile <ij|ab> of the pair (i,j) in double precision
+// Single precision tiles are converted into buffer and the large integrals of the
+// mixed mode are put back at their exact value.
+// Parameters:
+// - blocks: Integral blocks
+// - i, j: Active orbitals (i,j >= n_frozen, row i kept)
+// - buffer: n_virt x n_virt doubles, not used when the block is stored in double
+const double* blocks_tile_double(const eri_blocks_t* blocks, int i, int j, double* buffer)
+{
+    if (blocks->precision == BLOCKS_DOUBLE) return blocks_tile(blocks, i, j);
+
+    int64_t tile_size = (int64_t) blocks->n_virt * blocks->n_virt;
+    int64_t tile = blocks_tile_index(blocks, i, j);
+    const float* source = blocks->oovv_float + tile * tile_size;
+
+    for (int64_t n = 0; n < tile_size; n++)
+    {
+        buffer[n] = source[n];
+    }
+
+    if (blocks->precision == BLOCKS_MIXED)
+    {
+        for (int64_t m = blocks->large_start[tile]; m < blocks->large_start[tile + 1]; m++)
+        {
+            buffer[blocks->large[m].offset - tile * tile_size] = blocks->large[m].value;
+        }
+    }
+
+    return buffer;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,148 @@
+#ifndef BLOCKS_H
+#define BLOCKS_H
+
+#include <stdint.h>
+
+// Storage precision of the (ov|ov) block
+#define BLOCKS_DOUBLE 0     // All the integrals in double precision
+#define BLOCKS_FLOAT  1     // All the integrals in single precision
+#define BLOCKS_MIXED  2     // Single precision, with the large integrals also kept in double
+
+// Default magnitude above which an integral is kept in double by BLOCKS_MIXED
+#define BLOCKS_MIXED_THRESHOLD 1.0e-2
+
+// Smallest number of bytes of the slabs holding the tiles of a screened (ov|ov) block
+#define BLOCKS_SLAB_BYTES (2 * 1024 * 1024)
+
+// Number of (ov|ov) copies gathered before they are sorted by tile and written
+// (MP2_SCATTER=binned, the default MP2_SCATTER=direct writes them as they come)
+#define BLOCKS_BIN_SIZE (1 << 16)
+
+// Integral of the (ov|ov) block with its position
+typedef struct
+{
+    int64_t offset;     // Position in the (ov|ov) block
+    double value;
+} blocks_entry_t;
+
+// The only two-electron integral blocks needed by HF and MP2, stored densely.
+// oooo holds <ij|kl> with all indices occupied, laid out [i][j][k][l].
+// oovv holds <ij|ab> with i,j active (occupied, not frozen) and a,b virtual, laid out
+// [i][j][a][b] so that every (i,j) pair owns one contiguous n_virt x n_virt tile.
+// A distributed run keeps only a slice of its rows i: the active rows row_first,
+// row_first + row_stride, ... in that order, so that each process holds 1 / row_stride of it.
+// Large blocks are backed by huge pages, and the copies of each chunk can be binned by tile
+// so that the scatter writes one tile at a time instead of at random over the block.
+// In single or mixed precision, oovv is replaced by oovv_float (half the memory and the
+// memory traffic of the MP2 loop); the mixed mode also keeps the integrals larger than
+// large_threshold exactly, sorted by position, with large_start giving the range of each tile.
+// A screened block (screening > 0, double precision) drops the integrals smaller than screening
+// and is blocked-sparse: a tile only gets memory, from slabs of a few tiles, when one of its
+// integrals is kept, the others stay NULL in tile. blocks_finish then gives the Frobenius norm
+// of every tile, which bounds the energy of each pair before its tile is read.
+typedef struct
+{
+    int32_t n_occ;      // Number of occupied orbitals
+    int32_t n_virt;     // Number of virtual orbitals
+    int32_t n_frozen;   // Number of frozen core orbitals, left out of oovv
+    int32_t row_first;  // First active row i - n_frozen kept in oovv
+    int32_t row_stride; // Distance between the active rows kept in oovv (1: all of them)
+    int32_t n_rows;     // Number of active rows kept in oovv
+    double* oooo;       // All-occupied block (n_occ^4)
+    double* oovv;       // Active-active / virtual-virtual block (n_rows (n_occ - n_frozen) n_virt^2)
+    int64_t capacity_oooo;  // Number of doubles allocated in oooo
+    int64_t capacity_oovv;  // Number of doubles allocated in oovv
+    int32_t precision;      // BLOCKS_DOUBLE, BLOCKS_FLOAT or BLOCKS_MIXED
+    double large_threshold; // Magnitude of the integrals kept in double by BLOCKS_MIXED
+    float* oovv_float;      // Active-active / virtual-virtual block in single precision
+    int64_t capacity_oovv_float;
+    blocks_entry_t* large;  // Large integrals of the mixed mode, sorted by offset after blocks_finish
+    int64_t n_large;
+    int64_t capacity_large; // -1 once an allocation of the list failed
+    int64_t* large_start;   // First large integral of each tile (n_rows (n_occ - n_frozen) + 1)
+    int64_t capacity_large_start;
+    int32_t binned;         // 1 if the (ov|ov) copies are sorted by tile before being written
+    blocks_entry_t* bin;    // Copies waiting to be written, in arrival order (BLOCKS_BIN_SIZE)
+    blocks_entry_t* bin_sorted; // The same copies sorted by tile
+    int32_t* bin_tile;      // Tile of each waiting copy
+    int64_t n_bin;
+    int64_t* bin_start;     // Copies per tile, then first copy of each tile (n_rows (n_occ - n_frozen) + 1)
+    int64_t capacity_bin_start;
+    double screening;       // Magnitude below which the (ov|ov) integrals are dropped (0: dense block)
+    double** tile;          // Tile of each pair of a screened block, NULL if none of its integrals is kept
+    int64_t capacity_tile;
+    double* tile_norm;      // Frobenius norm of each tile of a screened block, after blocks_finish
+    int64_t capacity_tile_norm;
+    int64_t n_tile_kept;    // Tiles of a screened block holding integrals, -1 once a slab could not be allocated
+    double** slab;          // Slabs handed out to the tiles, kept for the next molecule
+    int64_t n_slab;
+    int64_t capacity_slab;
+    int64_t slab_bytes;     // Bytes of each slab
+    int64_t slab_used;      // Tiles handed out from the slab n_slab_used - 1
+    int64_t n_slab_used;
+} eri_blocks_t;
+
+// Function to read <ij|kl> from the all-occupied block
+static inline double blocks_oooo(const eri_blocks_t* blocks, int i, int j, int k, int l)
+{
+    int64_t o = blocks->n_occ;
+    return blocks->oooo[((i * o + j) * o + k) * o + l];
+}
+
+// Function to check whether the row i (>= n_frozen) of the (ov|ov) block is kept
+static inline int blocks_has_row(const eri_blocks_t* blocks, int i)
+{
+    return (i - blocks->n_frozen) % blocks->row_stride == blocks->row_first;
+}
+
+// Function to get the position of the tile of the pair (i,j) in the (ov|ov) block (row i kept)
+static inline int64_t blocks_tile_index(const eri_blocks_t* blocks, int i, int j)
+{
+    int64_t n_active = blocks->n_occ - blocks->n_frozen;
+    return (i - blocks->n_frozen) / blocks->row_stride * n_active + (j - blocks->n_frozen);
+}
+
+// Function to get the n_virt x n_virt tile <ij|ab> of the pair (i,j), with i,j >= n_frozen
+// and the row i kept. The exchange integrals <ij|ba> are the tile of the pair (j,i), read
+// row by row (or the transpose of this tile when the row j is not kept).
+// A screened block returns NULL for a tile without any integral kept.
+static inline const double* blocks_tile(const eri_blocks_t* blocks, int i, int j)
+{
+    int64_t v = blocks->n_virt;
+    if (blocks->tile != NULL) return blocks->tile[blocks_tile_index(blocks, i, j)];
+    return blocks->oovv + blocks_tile_index(blocks, i, j) * v * v;
+}
+
+// Function to get the Frobenius norm of the tile of the pair (i,j) of a screened block (row i kept)
+static inline double blocks_tile_norm(const eri_blocks_t* blocks, int i, int j)
+{
+    return blocks->tile_norm[blocks_tile_index(blocks, i, j)];
+}
+
+// Function to get the tile <ij|ab> in double precision whatever the storage, converted into
+// buffer (n_virt x n_virt doubles) unless the block is stored in double
+const double* blocks_tile_double(const eri_blocks_t* blocks, int i, int j, double* buffer);
+
+// Function to allocate zero-filled blocks for n_up occupied orbitals out of mo_num,
+// the n_frozen lowest ones being left out of the (ov|ov) block, of which only the active
+// rows row_first + k row_stride are kept (0 and 1 for the whole block). With screening > 0
+// (double precision only), the (ov|ov) block is screened and blocked-sparse.
+eri_blocks_t* blocks_alloc(int32_t n_up, int32_t mo_num, int32_t n_frozen, int32_t precision, double large_threshold,
+                           double screening, int32_t row_first, int32_t row_stride);
+
+// Function to free the blocks
+void blocks_free(eri_blocks_t* blocks);
+
+// Function to reuse the blocks for another molecule, growing them only when needed
+// (blocks may be NULL). Returns NULL if the allocation fails.
+eri_blocks_t* blocks_reserve(eri_blocks_t* blocks, int32_t n_up, int32_t mo_num, int32_t n_frozen, int32_t precision,
+                             double large_threshold, double screening, int32_t row_first, int32_t row_stride);
+
+// Function to sort the large integrals of the mixed mode, or to measure the tiles of a screened
+// block, once all the chunks are stored. Returns 0 on success, -1 if an allocation failed.
+int blocks_finish(eri_blocks_t* blocks);
+
+// Sink keeping only the (oo|oo) and (ov|ov) integrals of a chunk (target is an eri_blocks_t*)
+void blocks_sink(void* target, int64_t n, const int32_t* index, const double* value);
+
+#endif
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+// Header at the start of every cache file, followed by 64-byte aligned sections
+#define CACHE_MAGIC "MP2ERIC"
+#define CACHE_BYTE_ORDER 0x01020304u
+#define CACHE_ALIGN 64
+#define CACHE_SECTIONS 4        // data, mo_energy, packed store or oooo, oovv
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // Detects files written on a machine of other endianness
+    uint64_t key;
+    uint64_t hash;
+    int32_t layout;
+    int32_t n_up;
+    int32_t mo_num;
+    int32_t n_frozen;
+    int64_t n_integrals;
+    double nuclear_repulsion;
+    int64_t offset[CACHE_SECTIONS];     // Byte offset of each section
+    int64_t count[CACHE_SECTIONS];      // Number of doubles in each section
+} cache_header_t;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the key of a file from its metadata
+// 64-bit FNV-1a of the device, inode, size and modification time: a warm run only stats its input.
+// A file rewritten in place with its old size and modification time keeps its key, which only
+// the hash of the contents (cache_hash_file) tells apart.
+int cache_key_file(const char* filename, uint64_t* key)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0) return -1;
+
+    const uint64_t field[5] = { (uint64_t) st.st_dev, (uint64_t) st.st_ino, (uint64_t) st.st_size,
+                                (uint64_t) st.st_mtim.tv_sec, (uint64_t) st.st_mtim.tv_nsec };
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (int n = 0; n < 5; n++)
+    {
+        h = (h ^ field[n]) * prime;
+    }
+
+    *key = h;
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to hash the contents of a file
+// 64-bit FNV-1a applied to 8-byte words, then to the trailing bytes and the length.
+int cache_hash_file(const char* filename, uint64_t* hash)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) return -1;
+
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t h = 0xcbf29ce484222325ull;
+    uint64_t length = 0;
+
+    size_t buffer_size = 1 << 20;
+    unsigned char* buffer = malloc(buffer_size);
+    if (buffer == NULL)
+    {
+        fclose(file);
+        return -1;
+    }
+
+    size_t n_read;
+    while ((n_read = fread(buffer, 1, buffer_size, file)) > 0)
+    {
+        size_t n_words = n_read / 8;
+        for (size_t n = 0; n < n_words; n++)
+        {
+            uint64_t word;
+            memcpy(&word, buffer + 8 * n, 8);
+            h = (h ^ word) * prime;
+        }
+        for (size_t n = 8 * n_words; n < n_read; n++)
+        {
+            h = (h ^ buffer[n]) * prime;
+        }
+        length += n_read;
+    }
+
+    h = (h ^ length) * prime;
+    free(buffer);
+    fclose(file);
+
+    *hash = h;
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to build the name of the cache file of an input
+// Parameters:
+// - path, size: Output buffer
+// - cache_dir: Directory holding the cache files
+// - input_filename: TREXIO file (only its base name without extension is used)
+// - key: Key of the TREXIO file
+// - layout: Integral storage of the cache
+// - n_frozen: Number of frozen core orbitals (ignored for the packed store)
+void cache_filename(char* path, size_t size, const char* cache_dir, const char* input_filename, uint64_t key,
+                    int layout, int n_frozen)
+{
+    const char* name = strrchr(input_filename, '/');
+    name = (name == NULL) ? input_filename : name + 1;
+    const char* dot = strrchr(name, '.');
+    int length = (dot == NULL) ? (int) strlen(name) : (int) (dot - name);
+
+    if (layout == CACHE_LAYOUT_PACKED)
+        snprintf(path, size, "%s/%.*s-%016llx-full.mp2c", cache_dir, length, name, (unsigned long long) key);
+    else if (n_frozen > 0)
+        snprintf(path, size, "%s/%.*s-%016llx-blocks-fc%d.mp2c", cache_dir, length, name, (unsigned long long) key, n_frozen);
+    else
+        snprintf(path, size, "%s/%.*s-%016llx-blocks.mp2c", cache_dir, length, name, (unsigned long long) key);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to fill the section sizes of a cache from its dimensions
+static void cache_sections(const mp2_cache_t* cache, int64_t count[CACHE_SECTIONS])
+{
+    int64_t o = cache->n_up;
+    int64_t a = cache->n_up - cache->n_frozen;
+    int64_t v = cache->mo_num - cache->n_up;
+    int64_t n_pair = (int64_t) cache->mo_num * (cache->mo_num + 1) / 2;
+
+    count[0] = (int64_t) cache->mo_num * cache->mo_num;
+    count[1] = cache->mo_num;
+    if (cache->layout == CACHE_LAYOUT_PACKED)
+    {
+        count[2] = n_pair * (n_pair + 1) / 2;
+        count[3] = 0;
+    }
+    else
+    {
+        count[2] = o * o * o * o;
+        count[3] = a * a * v * v;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to map a cache file
+// The integral arrays are used in place: the first access to each page is served
+// by the page cache instead of HDF5 decompression and unpacking.
+// Parameters:
+// - cache: Receives the views into the mapping
+// - path: Cache file
+// - key: Expected key of the source file
+// - layout: Expected integral storage
+// - n_frozen: Expected number of frozen core orbitals (0 for the packed store)
+int cache_open(mp2_cache_t* cache, const char* path, uint64_t key, int layout, int n_frozen)
+{
+    memset(cache, 0, sizeof(mp2_cache_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(cache_header_t))
+    {
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const cache_header_t* header = (const cache_header_t*) map;
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != CACHE_VERSION ||
+        header->byte_order != CACHE_BYTE_ORDER || header->key != key || header->layout != layout ||
+        header->n_frozen != n_frozen || header->n_frozen < 0 || header->n_frozen > header->n_up)
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    cache->key = key;
+    cache->hash = header->hash;
+    cache->layout = layout;
+    cache->nuclear_repulsion = header->nuclear_repulsion;
+    cache->n_up = header->n_up;
+    cache->mo_num = header->mo_num;
+    cache->n_frozen = header->n_frozen;
+    cache->n_integrals = header->n_integrals;
+
+    // Reject truncated files and sections that do not match the dimensions
+    int64_t count[CACHE_SECTIONS];
+    cache_sections(cache, count);
+    for (int n = 0; n < CACHE_SECTIONS; n++)
+    {
+        if (header->count[n] != count[n] ||
+            (count[n] > 0 && header->offset[n] + count[n] * (int64_t) sizeof(double) > st.st_size))
+        {
+            munmap(map, st.st_size);
+            return -1;
+        }
+    }
+
+    char* base = (char*) map;
+    cache->data = (double*) (base + header->offset[0]);
+    cache->mo_energy = (double*) (base + header->offset[1]);
+    if (layout == CACHE_LAYOUT_PACKED)
+    {
+        cache->eri.mo_num = cache->mo_num;
+        cache->eri.size = count[2];
+        cache->eri.value = (double*) (base + header->offset[2]);
+    }
+    else
+    {
+        cache->blocks.n_occ = cache->n_up;
+        cache->blocks.n_virt = cache->mo_num - cache->n_up;
+        cache->blocks.n_frozen = cache->n_frozen;
+        cache->blocks.row_stride = 1;
+        cache->blocks.n_rows = cache->n_up - cache->n_frozen;
+        cache->blocks.oooo = (double*) (base + header->offset[2]);
+        cache->blocks.oovv = (double*) (base + header->offset[3]);
+    }
+
+    cache->map = map;
+    cache->map_size = st.st_size;
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to unmap a cache file
+void cache_close(mp2_cache_t* cache)
+{
+    if (cache->map != NULL) munmap(cache->map, cache->map_size);
+    cache->map = NULL;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write a cache file
+// The file is written under a temporary name and renamed once complete, so that
+// concurrent runs never map a partially written cache.
+// Parameters:
+// - path: Cache file
+// - cache: Dimensions and arrays to save
+int cache_write(const char* path, const mp2_cache_t* cache)
+{
+    cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.key = cache->key;
+    header.hash = cache->hash;
+    header.layout = cache->layout;
+    header.n_up = cache->n_up;
+    header.mo_num = cache->mo_num;
+    header.n_frozen = cache->n_frozen;
+    header.n_integrals = cache->n_integrals;
+    header.nuclear_repulsion = cache->nuclear_repulsion;
+
+    const double* section[CACHE_SECTIONS] = { cache->data, cache->mo_energy, NULL, NULL };
+    if (cache->layout == CACHE_LAYOUT_PACKED)
+    {
+        section[2] = cache->eri.value;
+    }
+    else
+    {
+        section[2] = cache->blocks.oooo;
+        section[3] = cache->blocks.oovv;
+    }
+
+    cache_sections(cache, header.count);
+    int64_t offset = sizeof(cache_header_t);
+    for (int n = 0; n < CACHE_SECTIONS; n++)
+    {
+        offset = (offset + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+        header.offset[n] = offset;
+        offset += header.count[n] * sizeof(double);
+    }
+
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.XXXXXX", path);
+    int fd = mkstemp(temporary);
+    if (fd < 0) return -1;
+
+    FILE* file = fdopen(fd, "wb");
+    if (file == NULL)
+    {
+        close(fd);
+        unlink(temporary);
+        return -1;
+    }
+
+    int ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    for (int n = 0; n < CACHE_SECTIONS && ok; n++)
+    {
+        if (fseek(file, header.offset[n], SEEK_SET) != 0) ok = 0;
+        if (ok && header.count[n] > 0)
+            ok = (fwrite(section[n], sizeof(double), header.count[n], file) == (size_t) header.count[n]);
+    }
+
+    if (fclose(file) != 0) ok = 0;
+
+    // mkstemp creates the file readable by its owner only
+    if (ok) chmod(temporary, 0644);
+    if (!ok || rename(temporary, path) != 0)
+    {
+        unlink(temporary);
+        return -1;
+    }
+
+    return 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
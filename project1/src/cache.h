@@ -0,0 +1,57 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "eri.h"
+#include "blocks.h"
+
+// Version of the binary cache format, to be increased whenever the layout changes
+#define CACHE_VERSION 3
+
+// Integral storage saved in a cache file
+#define CACHE_LAYOUT_BLOCKS 0   // (oo|oo) and (ov|ov) blocks
+#define CACHE_LAYOUT_PACKED 1   // Symmetry-packed store of all the unique integrals
+
+// Everything the HF and MP2 calculations read from a TREXIO file.
+// When opened from disk, the arrays point directly into the read-only mapping.
+typedef struct
+{
+    uint64_t key;               // Key of the source TREXIO file (device, inode, size and modification time)
+    uint64_t hash;              // Hash of the contents of the source file
+    int32_t layout;             // CACHE_LAYOUT_BLOCKS or CACHE_LAYOUT_PACKED
+    double nuclear_repulsion;
+    int32_t n_up;
+    int32_t mo_num;
+    int32_t n_frozen;           // Frozen core orbitals left out of the (ov|ov) block (blocks only)
+    int64_t n_integrals;
+    double* data;               // One-electron integrals (mo_num x mo_num)
+    double* mo_energy;          // Orbital energies
+    eri_t eri;                  // Packed store (CACHE_LAYOUT_PACKED)
+    eri_blocks_t blocks;        // Integral blocks (CACHE_LAYOUT_BLOCKS)
+    void* map;                  // Mapping of the cache file (NULL if not opened from disk)
+    size_t map_size;
+} mp2_cache_t;
+
+// Function to compute the key of a file from its metadata, without reading it. Returns 0 on success.
+int cache_key_file(const char* filename, uint64_t* key);
+
+// Function to hash the contents of a file. Returns 0 on success.
+int cache_hash_file(const char* filename, uint64_t* hash);
+
+// Function to build the name of the cache file of an input: <cache_dir>/<name>-<key>-<layout>.mp2c,
+// with the number of frozen orbitals appended to the layout of the blocks (e.g. blocks-fc2)
+void cache_filename(char* path, size_t size, const char* cache_dir, const char* input_filename, uint64_t key,
+                    int layout, int n_frozen);
+
+// Function to map a cache file. Returns 0 on success, -1 if the file is missing,
+// from another version or does not match the expected key, layout and frozen core.
+int cache_open(mp2_cache_t* cache, const char* path, uint64_t key, int layout, int n_frozen);
+
+// Function to unmap a cache file opened with cache_open
+void cache_close(mp2_cache_t* cache);
+
+// Function to write a cache file (through a temporary file renamed at the end). Returns 0 on success.
+int cache_write(const char* path, const mp2_cache_t* cache);
+
+#endif
@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cholesky.h"
+
+// Only the diagonal elements above this fraction of the largest one are taken as pivots
+// of a batch, which keeps the number of vectors close to that of the one-by-one algorithm
+#define CHOLESKY_SPAN 1.0e-2
+
+// Number of vectors contracted at a time when assembling a tile
+#define CHOLESKY_BLOCK 64
+
+// State shared with the sinks during the passes over the integral file
+typedef struct
+{
+    int o;                  // Number of occupied orbitals
+    int f;                  // Number of frozen core orbitals
+    int v;                  // Number of virtual orbitals
+    double* diagonal;       // (ia|ia), first pass only
+    double* oooo;           // All-occupied block, first pass only
+    const int* slot;        // Column of each ia in the batch (-1 if not a pivot)
+    double* column;         // Pivot columns (ia|jb), one row of (o-f)*v per pivot jb
+} cholesky_pass_t;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to get the compound index ia of a chemist pair (pq|, or -1 if it is not active-virtual
+static inline int64_t cholesky_ov(const cholesky_pass_t* pass, int p, int q)
+{
+    if (p >= pass->f && p < pass->o && q >= pass->o) return (int64_t) (p - pass->f) * pass->v + (q - pass->o);
+    if (q >= pass->f && q < pass->o && p >= pass->o) return (int64_t) (q - pass->f) * pass->v + (p - pass->o);
+    return -1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Sink of the first pass: keeps the diagonal (ia|ia) and the (oo|oo) block
+// In physicist notation <ij|kl> = (ik|jl), so the chemist pairs are (i,k) and (j,l).
+static void cholesky_sink_diagonal(void* target, int64_t n, const int32_t* index, const double* value)
+{
+    cholesky_pass_t* pass = (cholesky_pass_t*) target;
+    int64_t o = pass->o;
+
+    for (int64_t m = 0; m < n; m++)
+    {
+        int i = index[4 * m + 0];
+        int j = index[4 * m + 1];
+        int k = index[4 * m + 2];
+        int l = index[4 * m + 3];
+        double x = value[m];
+
+        if (i < o && j < o && k < o && l < o)
+        {
+            // Same 8 symmetric copies as in blocks_sink
+            pass->oooo[((i * o + j) * o + k) * o + l] = x;
+            pass->oooo[((k * o + l) * o + i) * o + j] = x;
+            pass->oooo[((k * o + j) * o + i) * o + l] = x;
+            pass->oooo[((i * o + l) * o + k) * o + j] = x;
+            pass->oooo[((j * o + i) * o + l) * o + k] = x;
+            pass->oooo[((l * o + k) * o + j) * o + i] = x;
+            pass->oooo[((j * o + k) * o + l) * o + i] = x;
+            pass->oooo[((l * o + i) * o + j) * o + k] = x;
+            continue;
+        }
+
+        int64_t x_ov = cholesky_ov(pass, i, k);
+        if (x_ov >= 0 && x_ov == cholesky_ov(pass, j, l)) pass->diagonal[x_ov] = x;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Sink of the later passes: gathers the columns (ia|jb) of the pivots jb of the batch
+static void cholesky_sink_columns(void* target, int64_t n, const int32_t* index, const double* value)
+{
+    cholesky_pass_t* pass = (cholesky_pass_t*) target;
+    int64_t n_ov = (int64_t) (pass->o - pass->f) * pass->v;
+
+    for (int64_t m = 0; m < n; m++)
+    {
+        int64_t x_ov = cholesky_ov(pass, index[4 * m + 0], index[4 * m + 2]);
+        if (x_ov < 0) continue;
+        int64_t y_ov = cholesky_ov(pass, index[4 * m + 1], index[4 * m + 3]);
+        if (y_ov < 0) continue;
+
+        // The matrix is symmetric: (ia|jb) is also the element (jb|ia)
+        if (pass->slot[y_ov] >= 0) pass->column[pass->slot[y_ov] * n_ov + x_ov] = value[m];
+        if (pass->slot[x_ov] >= 0) pass->column[pass->slot[x_ov] * n_ov + y_ov] = value[m];
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to allocate an empty decomposition with its (oo|oo) block
+static eri_cholesky_t* cholesky_alloc(int32_t n_up, int32_t mo_num, int32_t n_frozen)
+{
+    eri_cholesky_t* cholesky = calloc(1, sizeof(eri_cholesky_t));
+    if (cholesky == NULL) return NULL;
+
+    int64_t o = n_up;
+    cholesky->n_occ = n_up;
+    cholesky->n_virt = mo_num - n_up;
+    cholesky->n_frozen = n_frozen;
+    cholesky->occ.n_occ = n_up;
+    cholesky->occ.n_virt = mo_num - n_up;
+    cholesky->occ.capacity_oooo = o * o * o * o;
+    cholesky->occ.oooo = calloc(cholesky->occ.capacity_oooo, sizeof(double));
+    if (cholesky->occ.oooo == NULL)
+    {
+        free(cholesky);
+        return NULL;
+    }
+
+    return cholesky;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to free a decomposition
+void cholesky_free(eri_cholesky_t* cholesky)
+{
+    if (cholesky == NULL) return;
+    free(cholesky->vector);
+    free(cholesky->occ.oooo);
+    free(cholesky);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to select the pivots of the next batch: the largest remaining diagonal
+// elements above both the threshold and CHOLESKY_SPAN times the largest one
+// Returns the number of pivots written to pivot.
+static int cholesky_select(const double* diagonal, int64_t n_ov, double threshold, int* pivot)
+{
+    double d_max = 0.0;
+    for (int64_t p = 0; p < n_ov; p++)
+    {
+        if (diagonal[p] > d_max) d_max = diagonal[p];
+    }
+    if (d_max <= threshold) return 0;
+
+    double bound = CHOLESKY_SPAN * d_max;
+    if (bound < threshold) bound = threshold;
+
+    // Insertion into a short list sorted by decreasing diagonal
+    int n_pivot = 0;
+    for (int64_t p = 0; p < n_ov; p++)
+    {
+        if (diagonal[p] <= bound) continue;
+        if (n_pivot == CHOLESKY_BATCH && diagonal[p] <= diagonal[pivot[n_pivot - 1]]) continue;
+
+        int n = (n_pivot < CHOLESKY_BATCH) ? n_pivot++ : n_pivot - 1;
+        while (n > 0 && diagonal[pivot[n - 1]] < diagonal[p])
+        {
+            pivot[n] = pivot[n - 1];
+            n--;
+        }
+        pivot[n] = (int) p;
+    }
+
+    return n_pivot;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to decompose the (ia|jb) integral matrix with a batched pivoted Cholesky algorithm
+// The matrix is never stored: the first pass over the file keeps its diagonal (and the
+// (oo|oo) block), then every pass gathers the columns of a batch of pivots, from which
+// the vectors are built one pivot at a time. The decomposition stops when no diagonal
+// element of the remainder exceeds the threshold, which also bounds every element of
+// the remainder. The memory is O(o v K) for K vectors, instead of O(o^2 v^2).
+// Parameters:
+// - file: Open TREXIO file
+// - chunk_size: Number of integrals read per call
+// - buffer: Read buffers kept between calls (NULL: temporary buffers)
+// - n_up: Number of occupied orbitals
+// - mo_num: Total number of molecular orbitals
+// - n_frozen: Number of frozen core orbitals, left out of the decomposition
+// - threshold: Largest diagonal element left in the remainder
+// - cholesky: Receives the decomposition (to be freed with cholesky_free)
+trexio_exit_code cholesky_decompose(trexio_t* file, int64_t chunk_size, eri_buffer_t* buffer, int32_t n_up,
+                                    int32_t mo_num, int32_t n_frozen, double threshold, eri_cholesky_t** cholesky)
+{
+    *cholesky = NULL;
+    eri_cholesky_t* result = cholesky_alloc(n_up, mo_num, n_frozen);
+    if (result == NULL) return TREXIO_ALLOCATION_FAILED;
+
+    int64_t o = n_up - n_frozen;
+    int64_t v = mo_num - n_up;
+    int64_t n_ov = o * v;
+
+    cholesky_pass_t pass;
+    pass.o = n_up;
+    pass.f = n_frozen;
+    pass.v = mo_num - n_up;
+    pass.diagonal = calloc(n_ov > 0 ? n_ov : 1, sizeof(double));
+    pass.oooo = result->occ.oooo;
+
+    int* slot = malloc((n_ov > 0 ? n_ov : 1) * sizeof(int));
+    int pivot[CHOLESKY_BATCH];
+    pass.slot = slot;
+    pass.column = malloc((n_ov > 0 ? n_ov : 1) * CHOLESKY_BATCH * sizeof(double));
+
+    // Vectors are built as rows L_K(ia) and grown as needed
+    int64_t capacity = 0;
+    double* rows = NULL;
+
+    trexio_exit_code rc = TREXIO_ALLOCATION_FAILED;
+    if (pass.diagonal == NULL || slot == NULL || pass.column == NULL) goto cleanup;
+
+    rc = eri_stream(file, chunk_size, buffer, cholesky_sink_diagonal, &pass);
+    if (rc != TREXIO_SUCCESS) goto cleanup;
+    result->n_pass = 1;
+
+    for (int64_t p = 0; p < n_ov; p++) slot[p] = -1;
+
+    int n_pivot;
+    while ((n_pivot = cholesky_select(pass.diagonal, n_ov, threshold, pivot)) > 0)
+    {
+        //--------------------------------------------------------------------------------//
+        //                   GATHERING THE PIVOT COLUMNS FROM THE FILE                    //
+        //--------------------------------------------------------------------------------//
+
+        for (int c = 0; c < n_pivot; c++) slot[pivot[c]] = c;
+        memset(pass.column, 0, n_pivot * n_ov * sizeof(double));
+
+        rc = eri_stream(file, chunk_size, buffer, cholesky_sink_columns, &pass);
+        if (rc != TREXIO_SUCCESS) goto cleanup;
+        result->n_pass++;
+
+        for (int c = 0; c < n_pivot; c++) slot[pivot[c]] = -1;
+
+        // Remove the part of the columns already described by the previous vectors
+        for (int c = 0; c < n_pivot; c++)
+        {
+            double* column = pass.column + c * n_ov;
+            for (int64_t K = 0; K < result->n_vec; K++)
+            {
+                const double* row = rows + K * n_ov;
+                double factor = row[pivot[c]];
+                if (factor == 0.0) continue;
+                for (int64_t p = 0; p < n_ov; p++) column[p] -= factor * row[p];
+            }
+        }
+
+        //--------------------------------------------------------------------------------//
+        //                      BUILDING THE VECTORS OF THE BATCH                         //
+        //--------------------------------------------------------------------------------//
+
+        double bound = 0.0;
+        for (int c = 0; c < n_pivot; c++)
+        {
+            if (pass.diagonal[pivot[c]] > bound) bound = pass.diagonal[pivot[c]];
+        }
+        bound *= CHOLESKY_SPAN;
+        if (bound < threshold) bound = threshold;
+
+        while (1)
+        {
+            // Largest remaining diagonal among the pivots of the batch
+            int best = -1;
+            for (int c = 0; c < n_pivot; c++)
+            {
+                if (pivot[c] >= 0 && (best < 0 || pass.diagonal[pivot[c]] > pass.diagonal[pivot[best]])) best = c;
+            }
+            if (best < 0 || pass.diagonal[pivot[best]] <= bound) break;
+
+            if (result->n_vec == capacity)
+            {
+                int64_t new_capacity = (capacity == 0) ? CHOLESKY_BATCH : 2 * capacity;
+                if (new_capacity > n_ov) new_capacity = n_ov;
+                double* new_rows = realloc(rows, new_capacity * n_ov * sizeof(double));
+                if (new_rows == NULL)
+                {
+                    rc = TREXIO_ALLOCATION_FAILED;
+                    goto cleanup;
+                }
+                rows = new_rows;
+                capacity = new_capacity;
+            }
+
+            double* row = rows + result->n_vec * n_ov;
+            const double* column = pass.column + best * n_ov;
+            double scale = 1.0 / sqrt(pass.diagonal[pivot[best]]);
+            for (int64_t p = 0; p < n_ov; p++) row[p] = column[p] * scale;
+
+            for (int c = 0; c < n_pivot; c++)
+            {
+                if (c == best || pivot[c] < 0) continue;
+                double* other = pass.column + c * n_ov;
+                double factor = row[pivot[c]];
+                for (int64_t p = 0; p < n_ov; p++) other[p] -= factor * row[p];
+            }
+
+            for (int64_t p = 0; p < n_ov; p++) pass.diagonal[p] -= row[p] * row[p];
+            pass.diagonal[pivot[best]] = 0.0;
+            pivot[best] = -1;
+            result->n_vec++;
+        }
+    }
+
+    //--------------------------------------------------------------------------------//
+    //                   REORDERING THE VECTORS BY ACTIVE ORBITAL                     //
+    //--------------------------------------------------------------------------------//
+
+    int64_t K = result->n_vec;
+    result->vector = malloc((o * K * v > 0 ? o * K * v : 1) * sizeof(double));
+    if (result->vector == NULL)
+    {
+        rc = TREXIO_ALLOCATION_FAILED;
+        goto cleanup;
+    }
+
+    for (int64_t i = 0; i < o; i++)
+    {
+        for (int64_t k = 0; k < K; k++)
+        {
+            memcpy(result->vector + (i * K + k) * v, rows + k * n_ov + i * v, v * sizeof(double));
+        }
+    }
+
+    rc = TREXIO_SUCCESS;
+
+cleanup:
+    free(rows);
+    free(pass.diagonal);
+    free(pass.column);
+    free(slot);
+
+    if (rc == TREXIO_SUCCESS)
+        *cholesky = result;
+    else
+        cholesky_free(result);
+    return rc;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to assemble the tile <ij|ab> = sum_K L_K(ia) L_K(jb) of the pair (i,j)
+// The product is accumulated row by row over blocks of vectors, so that the inner
+// loop runs over contiguous b and a block of L_K(jb) stays in cache for all the a.
+// Parameters:
+// - cholesky: Decomposition
+// - i, j: Occupied orbitals of the pair
+// - tile: Receives the n_virt x n_virt tile
+void cholesky_tile(const eri_cholesky_t* cholesky, int i, int j, double* tile)
+{
+    int64_t v = cholesky->n_virt;
+    int64_t n_vec = cholesky->n_vec;
+    const double* l_i = cholesky_vectors(cholesky, i);
+    const double* l_j = cholesky_vectors(cholesky, j);
+
+    memset(tile, 0, v * v * sizeof(double));
+
+    for (int64_t k0 = 0; k0 < n_vec; k0 += CHOLESKY_BLOCK)
+    {
+        int64_t k1 = (k0 + CHOLESKY_BLOCK < n_vec) ? k0 + CHOLESKY_BLOCK : n_vec;
+        for (int64_t a = 0; a < v; a++)
+        {
+            double* restrict row = tile + a * v;
+            for (int64_t k = k0; k < k1; k++)
+            {
+                double factor = l_i[k * v + a];
+                const double* restrict l_jk = l_j + k * v;
+                for (int64_t b = 0; b < v; b++) row[b] += factor * l_jk[b];
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,47 @@
+#ifndef CHOLESKY_H
+#define CHOLESKY_H
+
+#include <stdint.h>
+#include <trexio.h>
+#include "eri.h"
+#include "blocks.h"
+
+// Default threshold on the largest remaining diagonal of the decomposition
+#define CHOLESKY_THRESHOLD_DEFAULT 1.0e-6
+
+// Number of pivot columns gathered per pass over the integral file
+#define CHOLESKY_BATCH 64
+
+// Pivoted Cholesky decomposition of the (ia|jb) integral matrix, with i,j active (occupied,
+// not frozen) and a,b virtual: <ij|ab> = (ia|jb) ~ sum_K L_K(ia) L_K(jb), exact up to the
+// threshold. The vectors of each active orbital i are stored as one n_vec x n_virt matrix
+// [i][K][a], so that the tile of a pair (i,j) is a product of two such matrices.
+typedef struct
+{
+    int32_t n_occ;      // Number of occupied orbitals
+    int32_t n_virt;     // Number of virtual orbitals
+    int32_t n_frozen;   // Number of frozen core orbitals, left out of the decomposition
+    int64_t n_vec;      // Number of Cholesky vectors
+    double* vector;     // Cholesky vectors ((n_occ - n_frozen) x n_vec x n_virt)
+    eri_blocks_t occ;   // All-occupied block for the HF energy (occ.oovv is not used)
+    int n_pass;         // Number of passes made over the integral file
+} eri_cholesky_t;
+
+// Function to get the n_vec x n_virt matrix L_K(ia) of the active orbital i (i >= n_frozen)
+static inline const double* cholesky_vectors(const eri_cholesky_t* cholesky, int i)
+{
+    return cholesky->vector + (int64_t) (i - cholesky->n_frozen) * cholesky->n_vec * cholesky->n_virt;
+}
+
+// Function to decompose the (ia|jb) integrals of a TREXIO file, reading it once for the
+// diagonal and the (oo|oo) block, then once per batch of pivots (buffer may be NULL).
+trexio_exit_code cholesky_decompose(trexio_t* file, int64_t chunk_size, eri_buffer_t* buffer, int32_t n_up,
+                                    int32_t mo_num, int32_t n_frozen, double threshold, eri_cholesky_t** cholesky);
+
+// Function to free a decomposition
+void cholesky_free(eri_cholesky_t* cholesky);
+
+// Function to assemble the n_virt x n_virt tile <ij|ab> of the pair (i,j) from the vectors
+void cholesky_tile(const eri_cholesky_t* cholesky, int i, int j, double* tile);
+
+#endif
@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "eri.h"
+#include "profile.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to allocate the packed two-electron integral store
+// Parameters:
+// - mo_num: Total number of molecular orbitals
+// Returns NULL if the allocation fails.
+eri_t* eri_alloc(int32_t mo_num)
+{
+    eri_t* eri = malloc(sizeof(eri_t));
+    if (eri == NULL) return NULL;
+
+    // Number of unique (i,k) pairs, then number of unique pairs of pairs
+    int64_t n_pair = (int64_t) mo_num * (mo_num + 1) / 2;
+
+    eri->mo_num   = mo_num;
+    eri->size     = n_pair * (n_pair + 1) / 2;
+    eri->capacity = eri->size;
+
+    // Integrals absent from the TREXIO file are zero
+    eri->value = calloc(eri->size, sizeof(double));
+    if (eri->value == NULL)
+    {
+        free(eri);
+        return NULL;
+    }
+
+    return eri;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to free the packed two-electron integral store
+void eri_free(eri_t* eri)
+{
+    if (eri == NULL) return;
+    free(eri->value);
+    free(eri);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to reuse a packed store for another molecule
+// The array is only reallocated when it is too small, otherwise it is just cleared.
+// Parameters:
+// - eri: Store of a previous molecule (or NULL)
+// - mo_num: Total number of molecular orbitals of the new molecule
+eri_t* eri_reserve(eri_t* eri, int32_t mo_num)
+{
+    if (eri == NULL) return eri_alloc(mo_num);
+
+    int64_t n_pair = (int64_t) mo_num * (mo_num + 1) / 2;
+    int64_t size = n_pair * (n_pair + 1) / 2;
+
+    if (size > eri->capacity)
+    {
+        free(eri->value);
+        eri->value = calloc(size, sizeof(double));
+        if (eri->value == NULL)
+        {
+            free(eri);
+            return NULL;
+        }
+        eri->capacity = size;
+    }
+    else
+    {
+        memset(eri->value, 0, size * sizeof(double));
+    }
+
+    eri->mo_num = mo_num;
+    eri->size   = size;
+    return eri;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to free the chunk read buffers
+void eri_buffer_free(eri_buffer_t* buffer)
+{
+    for (int slot = 0; slot < buffer->n_slots; slot++)
+    {
+        free(buffer->index[slot]);
+        free(buffer->value[slot]);
+        buffer->index[slot] = NULL;
+        buffer->value[slot] = NULL;
+    }
+    buffer->n_slots = 0;
+    buffer->capacity = 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Sink scattering a chunk of sparse integrals into the packed store
+void eri_sink_packed(void* target, int64_t n, const int32_t* index, const double* value)
+{
+    eri_t* eri = (eri_t*) target;
+
+    for (int64_t m = 0; m < n; m++)
+    {
+        eri_set(eri, index[4 * m + 0], index[4 * m + 1], index[4 * m + 2], index[4 * m + 3], value[m]);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to convert a memory budget for the read buffers into a chunk size
+// Parameters:
+// - memory_budget: Bytes allowed for all the index and value buffers (<= 0 selects the default chunk)
+// - depth: Number of chunk buffers sharing the budget
+int64_t eri_chunk_size(int64_t memory_budget, int depth)
+{
+    if (memory_budget <= 0) return ERI_CHUNK_DEFAULT;
+    if (depth < 1) depth = 1;
+
+    int64_t chunk_size = memory_budget / depth / (int64_t) ERI_RECORD_BYTES;
+    return (chunk_size > 0) ? chunk_size : 1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to make sure the read buffers hold n_slots chunks of chunk_size integrals
+// Returns TREXIO_ALLOCATION_FAILED (with the buffers freed) if the allocation fails.
+static trexio_exit_code eri_buffer_reserve(eri_buffer_t* buffer, int n_slots, int64_t chunk_size)
+{
+    if (buffer->capacity >= chunk_size && buffer->n_slots >= n_slots) return TREXIO_SUCCESS;
+
+    eri_buffer_free(buffer);
+    buffer->n_slots = n_slots;
+    for (int slot = 0; slot < n_slots; slot++)
+    {
+        buffer->index[slot] = malloc(4 * chunk_size * sizeof(int32_t));
+        buffer->value[slot] = malloc(chunk_size * sizeof(double));
+        if (buffer->index[slot] == NULL || buffer->value[slot] == NULL)
+        {
+            eri_buffer_free(buffer);
+            return TREXIO_ALLOCATION_FAILED;
+        }
+    }
+    buffer->capacity = chunk_size;
+    return TREXIO_SUCCESS;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Queue of chunk buffers shared by the reader thread and the consumer of a stream
+// The reader fills the slots in turn, the consumer empties them in the same order.
+typedef struct
+{
+    trexio_t* file;
+    eri_buffer_t* buffer;
+    int64_t chunk_size;
+    int64_t n_integrals;
+    int depth;
+    int64_t count[ERI_DEPTH_MAX];   // Integrals in each filled slot
+    int n_filled;                   // Slots filled and not yet consumed
+    int done;                       // The reader has stopped (end of file or error)
+    trexio_exit_code rc;            // Status of the reader
+    double read_time;               // Seconds spent by the reader in the TREXIO reads
+    pthread_mutex_t lock;
+    pthread_cond_t filled;          // Signalled when a slot is filled or the reader stops
+    pthread_cond_t emptied;         // Signalled when a slot is consumed
+} eri_queue_t;
+
+// Reader thread of a stream: reads the chunks at increasing offsets into the free slots
+static void* eri_reader(void* argument)
+{
+    eri_queue_t* queue = (eri_queue_t*) argument;
+    trexio_exit_code rc = TREXIO_SUCCESS;
+    int64_t offset = 0;
+    int slot = 0;
+
+    while (offset < queue->n_integrals)
+    {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->n_filled == queue->depth) pthread_cond_wait(&queue->emptied, &queue->lock);
+        pthread_mutex_unlock(&queue->lock);
+
+        int64_t count = queue->chunk_size;
+        if (count > queue->n_integrals - offset) count = queue->n_integrals - offset;
+
+        // TREXIO_END only signals that the last chunk was shorter than requested
+        double start = profile_clock();
+        rc = trexio_read_mo_2e_int_eri(queue->file, offset, &count, queue->buffer->index[slot], queue->buffer->value[slot]);
+        queue->read_time += profile_clock() - start;
+        if (rc != TREXIO_SUCCESS && rc != TREXIO_END) break;
+        rc = TREXIO_SUCCESS;
+        if (count <= 0) break;
+
+        pthread_mutex_lock(&queue->lock);
+        queue->count[slot] = count;
+        queue->n_filled++;
+        pthread_cond_signal(&queue->filled);
+        pthread_mutex_unlock(&queue->lock);
+
+        offset += count;
+        slot = (slot + 1) % queue->depth;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    queue->rc = rc;
+    queue->done = 1;
+    pthread_cond_signal(&queue->filled);
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to stream the integrals with a reader thread filling the queue ahead of the sink
+// Sets *started to 0 if the thread cannot be started (nothing was read), so that the caller reads
+// in turn; otherwise returns the exit code of the reads.
+static trexio_exit_code eri_stream_queued(trexio_t* file, int64_t n_integrals, int64_t chunk_size, int depth,
+                                          eri_buffer_t* buffer, eri_sink_t sink, void* target, int* started)
+{
+    *started = 0;
+
+    eri_queue_t queue;
+    memset(&queue, 0, sizeof(queue));
+    queue.file        = file;
+    queue.buffer      = buffer;
+    queue.chunk_size  = chunk_size;
+    queue.n_integrals = n_integrals;
+    queue.depth       = depth;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.filled, NULL);
+    pthread_cond_init(&queue.emptied, NULL);
+
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, eri_reader, &queue) != 0)
+    {
+        pthread_cond_destroy(&queue.emptied);
+        pthread_cond_destroy(&queue.filled);
+        pthread_mutex_destroy(&queue.lock);
+        return TREXIO_SUCCESS;
+    }
+    *started = 1;
+
+    int slot = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&queue.lock);
+        while (queue.n_filled == 0 && !queue.done) pthread_cond_wait(&queue.filled, &queue.lock);
+        int64_t count = (queue.n_filled > 0) ? queue.count[slot] : 0;
+        pthread_mutex_unlock(&queue.lock);
+        if (count == 0) break;
+
+        double start = profile_clock();
+        sink(target, count, buffer->index[slot], buffer->value[slot]);
+        buffer->stats.sink_time += profile_clock() - start;
+        buffer->stats.n_integrals += count;
+
+        pthread_mutex_lock(&queue.lock);
+        queue.n_filled--;
+        pthread_cond_signal(&queue.emptied);
+        pthread_mutex_unlock(&queue.lock);
+        slot = (slot + 1) % depth;
+    }
+
+    pthread_join(reader, NULL);
+    buffer->stats.read_time += queue.read_time;
+
+    pthread_cond_destroy(&queue.emptied);
+    pthread_cond_destroy(&queue.filled);
+    pthread_mutex_destroy(&queue.lock);
+    return queue.rc;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to stream the two-electron integrals from a TREXIO file
+// Fixed-size chunks are read at increasing offsets and each one is folded into the target
+// storage. With a depth of 1 the next read waits for the fold, so only one chunk is ever
+// resident; with a depth d >= 2 a reader thread keeps up to d chunks in flight, so that the
+// TREXIO reads overlap the folds (the sink always runs on the calling thread, in file order).
+// Parameters:
+// - file: Open TREXIO file (only used by the reader thread until the stream returns)
+// - chunk_size: Number of integrals read per call
+// - buffer: Read buffers kept between calls, grown if needed, and queue depth (NULL: temporary buffers)
+// - sink: Callback consuming each chunk
+// - target: Storage passed through to the sink
+trexio_exit_code eri_stream(trexio_t* file, int64_t chunk_size, eri_buffer_t* buffer, eri_sink_t sink, void* target)
+{
+    int64_t n_integrals;
+    trexio_exit_code rc = trexio_read_mo_2e_int_eri_size(file, &n_integrals);
+    if (rc != TREXIO_SUCCESS) return rc;
+
+    if (chunk_size > n_integrals) chunk_size = n_integrals;
+    if (chunk_size <= 0) return TREXIO_SUCCESS;
+
+    eri_buffer_t temporary;
+    memset(&temporary, 0, sizeof(temporary));
+    if (buffer == NULL) buffer = &temporary;
+
+    double stream_start = profile_clock();
+
+    // A single chunk leaves nothing to overlap
+    int depth = (buffer->depth > 0) ? buffer->depth : ERI_DEPTH_DEFAULT;
+    if (depth > ERI_DEPTH_MAX) depth = ERI_DEPTH_MAX;
+    if (chunk_size == n_integrals) depth = 1;
+
+    rc = eri_buffer_reserve(buffer, depth, chunk_size);
+    if (rc != TREXIO_SUCCESS) return rc;
+
+    if (depth >= 2)
+    {
+        int started;
+        rc = eri_stream_queued(file, n_integrals, chunk_size, depth, buffer, sink, target, &started);
+        if (started)
+        {
+            buffer->stats.stream_time += profile_clock() - stream_start;
+            eri_buffer_free(&temporary);
+            return rc;
+        }
+    }
+
+    int32_t* index = buffer->index[0];
+    double* value = buffer->value[0];
+
+    int64_t offset = 0;
+    while (offset < n_integrals)
+    {
+        int64_t count = chunk_size;
+        if (count > n_integrals - offset) count = n_integrals - offset;
+
+        // TREXIO_END only signals that the last chunk was shorter than requested
+        double start = profile_clock();
+        rc = trexio_read_mo_2e_int_eri(file, offset, &count, index, value);
+        double read = profile_clock();
+        if (rc != TREXIO_SUCCESS && rc != TREXIO_END) break;
+        rc = TREXIO_SUCCESS;
+        if (count <= 0) break;
+
+        sink(target, count, index, value);
+        offset += count;
+
+        buffer->stats.n_integrals += count;
+        buffer->stats.read_time += read - start;
+        buffer->stats.sink_time += profile_clock() - read;
+    }
+
+    buffer->stats.stream_time += profile_clock() - stream_start;
+    eri_buffer_free(&temporary);
+    return rc;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,103 @@
+#ifndef ERI_H
+#define ERI_H
+
+#include <stdint.h>
+#include <trexio.h>
+
+// Default number of integrals pulled from the TREXIO file per read
+#define ERI_CHUNK_DEFAULT 1048576
+
+// Default and largest number of chunk buffers in the read queue
+#define ERI_DEPTH_DEFAULT 2
+#define ERI_DEPTH_MAX 8
+
+// Size in bytes of one sparse integral record (four indices and a value)
+#define ERI_RECORD_BYTES (4 * sizeof(int32_t) + sizeof(double))
+
+// Symmetry-packed store for the two-electron integrals <ij|kl>.
+// Only the elements that are unique under the 8-fold permutational symmetry
+// are kept, in one contiguous array addressed by a canonical packed index.
+typedef struct
+{
+    int32_t mo_num;     // Number of molecular orbitals
+    int64_t size;       // Number of unique integrals stored
+    int64_t capacity;   // Number of doubles allocated in value
+    double* value;      // Packed integral values
+} eri_t;
+
+// Function to compute the packed index of an unordered pair (p,q)
+static inline int64_t eri_pair(int64_t p, int64_t q)
+{
+    return (p >= q) ? p * (p + 1) / 2 + q : q * (q + 1) / 2 + p;
+}
+
+// Function to compute the canonical packed index of <ij|kl>.
+// In physicist notation <ij|kl> = (ik|jl), so the symmetric pairs are (i,k) and (j,l).
+static inline int64_t eri_index(int i, int j, int k, int l)
+{
+    return eri_pair(eri_pair(i, k), eri_pair(j, l));
+}
+
+// Function to read the integral <ij|kl> from the packed store
+static inline double eri_get(const eri_t* eri, int i, int j, int k, int l)
+{
+    return eri->value[eri_index(i, j, k, l)];
+}
+
+// Function to store the integral <ij|kl> (and implicitly all its symmetric copies)
+static inline void eri_set(eri_t* eri, int i, int j, int k, int l, double value)
+{
+    eri->value[eri_index(i, j, k, l)] = value;
+}
+
+// Function to allocate a zero-filled packed store for mo_num orbitals
+eri_t* eri_alloc(int32_t mo_num);
+
+// Function to free the packed store
+void eri_free(eri_t* eri);
+
+// Function to reuse a packed store for mo_num orbitals, growing it only when needed
+// (eri may be NULL). Returns NULL if the allocation fails.
+eri_t* eri_reserve(eri_t* eri, int32_t mo_num);
+
+// Counters accumulated by the streams, for the instrumentation of the runs
+typedef struct
+{
+    int64_t n_integrals;    // Integrals read
+    double read_time;       // Seconds spent in the TREXIO reads
+    double sink_time;       // Seconds spent folding the chunks into their targets
+    double stream_time;     // Seconds spent in the streams (less than read + sink when they overlap)
+} eri_stats_t;
+
+// Read buffers for a queue of chunks of sparse integrals, reusable from one stream to the next
+// With a depth of 1 the chunks are read and folded in turn; with a depth of 2 or more a reader
+// thread fills the next buffers while the calling thread folds the previous chunk.
+typedef struct
+{
+    int depth;          // Number of chunk buffers in the queue (0 is taken as ERI_DEPTH_DEFAULT)
+    int n_slots;        // Number of chunk buffers allocated
+    int64_t capacity;   // Number of integrals each buffer can hold
+    int32_t* index[ERI_DEPTH_MAX];  // Four indices per integral
+    double* value[ERI_DEPTH_MAX];   // Integral values
+    eri_stats_t stats;  // Counters of the streams that used these buffers (not reset by the streams)
+} eri_buffer_t;
+
+// Function to free the read buffers
+void eri_buffer_free(eri_buffer_t* buffer);
+
+// Callback folding one chunk of n sparse integrals into a target storage
+typedef void (*eri_sink_t)(void* target, int64_t n, const int32_t* index, const double* value);
+
+// Sink scattering a chunk into a packed store (target is an eri_t*)
+void eri_sink_packed(void* target, int64_t n, const int32_t* index, const double* value);
+
+// Function to convert a memory budget in bytes, shared by the depth buffers of the queue,
+// into a chunk size in integrals
+int64_t eri_chunk_size(int64_t memory_budget, int depth);
+
+// Function to stream the two-electron integrals chunk by chunk into a sink, reading ahead
+// in a thread when buffer->depth >= 2 (buffer may be NULL, in which case temporary
+// buffers of the default depth are used)
+trexio_exit_code eri_stream(trexio_t* file, int64_t chunk_size, eri_buffer_t* buffer, eri_sink_t sink, void* target);
+
+#endif
@@ -0,0 +1,771 @@
+#include <stdio.h>
+#include <trexio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "utils.h"
+#include "mp2.h"
+#include "cache.h"
+#include "mp2_kernel.h"
+#include "laplace.h"
+
+// The HDF5 library behind TREXIO is not thread-safe: only one worker reads at a time
+static pthread_mutex_t trexio_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Loaded molecule and buffers of one user of the library
+struct mp2_context
+{
+    mp2_options_t options;      // Settings of every molecule of the context
+    mp2_workspace_t ws;         // Buffers reused from one molecule to the next
+    mp2_cache_t cache;          // Mapping of the integral cache, when the molecule came from it
+    mp2_result_t result;        // Sizes, energies, timings and status of the loaded molecule
+    int loaded;                 // 1 while a molecule is loaded
+    double* data;               // One-electron integrals of the loaded molecule
+    double* mo_energy;          // Orbital energies of the loaded molecule
+    const eri_t* eri;           // Packed integral store (full load)
+    const eri_blocks_t* blocks; // Integral blocks (blocks load)
+};
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to initialise an empty workspace
+void workspace_init(mp2_workspace_t* ws)
+{
+    memset(ws, 0, sizeof(mp2_workspace_t));
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to free all the buffers of a workspace
+void workspace_free(mp2_workspace_t* ws)
+{
+    free(ws->data);
+    free(ws->mo_energy);
+    eri_free(ws->eri);
+    blocks_free(ws->blocks);
+    cholesky_free(ws->cholesky);
+    eri_buffer_free(&ws->buffer);
+    workspace_init(ws);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to grow a workspace array to n doubles (kept as is when large enough)
+static double* workspace_grow(double* array, int64_t* capacity, int64_t n)
+{
+    if (n <= *capacity) return array;
+
+    free(array);
+    array = malloc(n * sizeof(double));
+    *capacity = (array == NULL) ? 0 : n;
+    return array;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to record a TREXIO error, close the file and release the reading lock
+static int job_error(mp2_result_t* result, trexio_t* file, const char* what, trexio_exit_code rc)
+{
+    snprintf(result->message, sizeof(result->message), "TREXIO Error %s: %s", what, trexio_string_of_error(rc));
+    result->status = -1;
+    if (file != NULL) trexio_close(file);
+    pthread_mutex_unlock(&trexio_lock);
+    return -1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to check that the frozen core leaves at least one correlated orbital
+static int job_check_frozen(mp2_result_t* result, int n_frozen)
+{
+    if (n_frozen >= 0 && n_frozen < result->n_up) return 0;
+
+    snprintf(result->message, sizeof(result->message), "Error: Cannot freeze %d of the %d occupied orbitals.",
+             n_frozen, result->n_up);
+    result->status = -1;
+    return -1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to read everything the calculation needs from a TREXIO file into the workspace
+// Parameters:
+// - input_filename: TREXIO file (.h5)
+// - options: Loading options
+// - ws: Buffers of the calling worker, reused between molecules
+// - result: Receives the dimensions, or the error message
+static int job_read_trexio(const char* input_filename, const mp2_options_t* options, mp2_workspace_t* ws, mp2_result_t* result)
+{
+    trexio_exit_code rc;
+    mp2_profile_t* profile = &result->profile;
+
+    //--------------------------------------------------------------------------------//
+    //                                 OPENING FILE                                   //
+    //--------------------------------------------------------------------------------//
+
+    pthread_mutex_lock(&trexio_lock);
+    double start = profile_clock();
+
+    trexio_t* file = trexio_open(input_filename, 'r', TREXIO_AUTO, &rc);
+    if (rc != TREXIO_SUCCESS) return job_error(result, NULL, "opening file", rc);
+
+    //--------------------------------------------------------------------------------//
+    //                     READING THE SCALARS AND ONE-ELECTRON DATA                  //
+    //--------------------------------------------------------------------------------//
+
+    rc = trexio_read_nucleus_repulsion(file, &result->nuclear_repulsion);
+    if (rc != TREXIO_SUCCESS) return job_error(result, file, "reading nuclear repulsion energy", rc);
+
+    rc = trexio_read_electron_up_num(file, &result->n_up);
+    if (rc != TREXIO_SUCCESS) return job_error(result, file, "reading number of up-spin electrons", rc);
+
+    rc = trexio_read_mo_num(file, &result->mo_num);
+    if (rc != TREXIO_SUCCESS) return job_error(result, file, "reading number of molecular orbitals", rc);
+
+    int32_t n_up = result->n_up;
+    int32_t mo_num = result->mo_num;
+
+    if (job_check_frozen(result, options->n_frozen) != 0)
+    {
+        trexio_close(file);
+        pthread_mutex_unlock(&trexio_lock);
+        return -1;
+    }
+
+    ws->data = workspace_grow(ws->data, &ws->data_capacity, (int64_t) mo_num * mo_num);
+    ws->mo_energy = workspace_grow(ws->mo_energy, &ws->mo_energy_capacity, mo_num);
+    if (ws->data == NULL || ws->mo_energy == NULL)
+        return job_error(result, file, "allocating one-electron arrays", TREXIO_ALLOCATION_FAILED);
+
+    rc = trexio_read_mo_1e_int_core_hamiltonian(file, ws->data);
+    if (rc != TREXIO_SUCCESS) return job_error(result, file, "reading one-electron integrals", rc);
+
+    rc = trexio_read_mo_energy(file, ws->mo_energy);
+    if (rc != TREXIO_SUCCESS) return job_error(result, file, "reading molecular orbital energies", rc);
+
+    profile->bytes_read += 3 * sizeof(double) + ((int64_t) mo_num * mo_num + mo_num) * sizeof(double);
+    profile->time[PROFILE_SETUP] += profile_clock() - start;
+
+    //--------------------------------------------------------------------------------//
+    //                          READING TWO-ELECTRON INTEGRALS                        //
+    //--------------------------------------------------------------------------------//
+
+    rc = trexio_read_mo_2e_int_eri_size(file, &result->n_integrals);
+    if (rc != TREXIO_SUCCESS) return job_error(result, file, "reading two-electron integrals size", rc);
+
+    // The sinks run on this thread while the reads may overlap them: the time of the streams
+    // not spent in the sinks waited for the file, anything else is Cholesky algebra
+    eri_stats_t before = ws->buffer.stats;
+    int64_t chunk_size = eri_chunk_size(options->memory_budget, options->read_depth);
+    ws->buffer.depth = options->read_depth;
+    start = profile_clock();
+
+    // The storage of the previous molecule is reused when it is large enough
+    if (options->load_mode == MP2_LOAD_CHOLESKY)
+    {
+        // The vectors depend on the molecule, nothing is worth keeping
+        cholesky_free(ws->cholesky);
+        rc = cholesky_decompose(file, chunk_size, &ws->buffer, n_up, mo_num,
+                                options->n_frozen, options->cholesky_threshold, &ws->cholesky);
+        if (rc == TREXIO_SUCCESS) result->n_cholesky = ws->cholesky->n_vec;
+    }
+    else if (options->load_mode == MP2_LOAD_FULL)
+    {
+        ws->eri = eri_reserve(ws->eri, mo_num);
+        if (ws->eri == NULL) return job_error(result, file, "allocating two-electron integrals", TREXIO_ALLOCATION_FAILED);
+        rc = eri_stream(file, chunk_size, &ws->buffer, eri_sink_packed, ws->eri);
+    }
+    else
+    {
+        ws->blocks = blocks_reserve(ws->blocks, n_up, mo_num, options->n_frozen, options->precision, options->mixed_threshold,
+                                    options->screening, options->rank, options->n_ranks);
+        if (ws->blocks == NULL) return job_error(result, file, "allocating two-electron integrals", TREXIO_ALLOCATION_FAILED);
+        rc = eri_stream(file, chunk_size, &ws->buffer, blocks_sink, ws->blocks);
+        if (rc == TREXIO_SUCCESS && blocks_finish(ws->blocks) != 0)
+            return job_error(result, file, (options->screening > 0.0) ? "allocating the screened tiles" : "allocating the large integrals",
+                             TREXIO_ALLOCATION_FAILED);
+    }
+    if (rc != TREXIO_SUCCESS) return job_error(result, file, "reading two-electron integrals", rc);
+
+    double read_time = ws->buffer.stats.read_time - before.read_time;
+    double sink_time = ws->buffer.stats.sink_time - before.sink_time;
+    double stream_time = ws->buffer.stats.stream_time - before.stream_time;
+    int64_t n_read = ws->buffer.stats.n_integrals - before.n_integrals;
+    profile->time[PROFILE_ERI_READ] += stream_time - sink_time;
+    profile->time[PROFILE_ERI_SCATTER] += sink_time;
+    if (read_time > stream_time - sink_time) profile->read_overlap += read_time - (stream_time - sink_time);
+    if (options->load_mode == MP2_LOAD_CHOLESKY)
+        profile->time[PROFILE_CHOLESKY] += profile_clock() - start - stream_time;
+    profile->integrals_read += n_read;
+    profile->bytes_read += n_read * (int64_t) ERI_RECORD_BYTES;
+
+    rc = trexio_close(file);
+    pthread_mutex_unlock(&trexio_lock);
+    if (rc != TREXIO_SUCCESS)
+    {
+        snprintf(result->message, sizeof(result->message), "TREXIO Error closing file: %s", trexio_string_of_error(rc));
+        result->status = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function returning the name of a load mode, as given on the command line
+static const char* job_load_mode_name(int load_mode)
+{
+    if (load_mode == MP2_LOAD_FULL) return "full";
+    if (load_mode == MP2_LOAD_CHOLESKY) return "cholesky";
+    return "blocks";
+}
+
+// Function returning the name of a storage precision, as given on the command line
+static const char* job_precision_name(int precision)
+{
+    if (precision == BLOCKS_FLOAT) return "float";
+    if (precision == BLOCKS_MIXED) return "mixed";
+    return "double";
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to count the floating-point operations of the MP2 step
+// Every element (a,b) of a pair costs 7 operations (denominator, reciprocal, and the direct
+// and exchange products and sums). The pair kernels do each unordered pair once, the
+// packed loop every ordered pair, and the Cholesky tiles cost 2 K per element to assemble.
+// The unordered pairs skipped by the screening cost nothing.
+static double job_mp2_flops(int load_mode, int64_t n_active, int64_t n_virt, int64_t n_cholesky, int n_laplace,
+                            int64_t n_skipped)
+{
+    double n_element = (double) n_virt * n_virt;
+    if (load_mode == MP2_LOAD_FULL) return 7.0 * n_active * n_active * n_element;
+
+    double n_pair = 0.5 * n_active * (n_active + 1) - n_skipped;
+    if (n_laplace > 0)
+    {
+        // Per point: weighted vectors, G_ii, G_ij of the other pairs and the two pair traces
+        double n_gram = (double) n_cholesky * n_cholesky;
+        return n_laplace * (2.0 * n_active * n_cholesky * n_virt + 2.0 * n_active * n_gram * n_virt +
+                            2.0 * (n_pair - n_active) * n_gram * n_virt + 4.0 * n_pair * n_gram);
+    }
+    double flops = 7.0 * n_pair * n_element;
+    if (load_mode == MP2_LOAD_CHOLESKY) flops += 2.0 * n_cholesky * n_pair * n_element;
+    return flops;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to set the default options (blocks in double precision, no frozen core, no cache)
+void mp2_options_default(mp2_options_t* options)
+{
+    memset(options, 0, sizeof(mp2_options_t));
+    options->load_mode = MP2_LOAD_BLOCKS;
+    options->precision = BLOCKS_DOUBLE;
+    options->mixed_threshold = BLOCKS_MIXED_THRESHOLD;
+    options->cholesky_threshold = CHOLESKY_THRESHOLD_DEFAULT;
+    options->read_depth = ERI_DEPTH_DEFAULT;
+    options->n_ranks = 1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to create a context with its own buffers
+// Parameters:
+// - options: Settings of every molecule of the context (NULL for the defaults)
+// Returns NULL if the allocation fails.
+mp2_context_t* mp2_context_create(const mp2_options_t* options)
+{
+    mp2_context_t* context = calloc(1, sizeof(mp2_context_t));
+    if (context == NULL) return NULL;
+
+    if (options != NULL)
+        context->options = *options;
+    else
+        mp2_options_default(&context->options);
+    workspace_init(&context->ws);
+    return context;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to release the molecule of a context, keeping its buffers
+static void mp2_unload(mp2_context_t* context)
+{
+    cache_close(&context->cache);
+    context->loaded = 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to free a context and all its buffers
+void mp2_context_free(mp2_context_t* context)
+{
+    if (context == NULL) return;
+    mp2_unload(context);
+    workspace_free(&context->ws);
+    free(context);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to load the integrals of a TREXIO file into a context
+// With a cache directory, the integrals are mapped from a binary cache keyed by the
+// metadata of the input file when one exists, and the cache is written after a TREXIO read.
+// The buffers of the previous molecule are reused when they are large enough.
+// Parameters:
+// - context: Context of the calculation
+// - input_filename: TREXIO file (.h5), which must outlive the results of the context
+int mp2_load(mp2_context_t* context, const char* input_filename)
+{
+    const mp2_options_t* options = &context->options;
+    mp2_workspace_t* ws = &context->ws;
+    mp2_result_t* result = &context->result;
+    mp2_profile_t* profile = &result->profile;
+    double phase_start;
+
+    mp2_unload(context);
+    memset(result, 0, sizeof(mp2_result_t));
+    result->input_filename = input_filename;
+
+    // Check if the filename has the .h5 extension
+    const char *extension = strrchr(input_filename, '.');
+    if (extension == NULL || strcmp(extension, ".h5") != 0)
+    {
+        snprintf(result->message, sizeof(result->message), "Error: Input file must have a .h5 extension.");
+        result->status = -1;
+        return -1;
+    }
+
+    // Only the (ov|ov) block is sliced between the processes of a distributed run
+    if (options->n_ranks > 1 && (options->load_mode != MP2_LOAD_BLOCKS || options->rank < 0 || options->rank >= options->n_ranks))
+    {
+        snprintf(result->message, sizeof(result->message), "Error: A distributed run needs -l blocks and 0 <= rank < n_ranks.");
+        result->status = -1;
+        return -1;
+    }
+
+    // Only the double precision blocks are screened
+    if (options->screening < 0.0 || (options->screening > 0.0 &&
+                                     (options->load_mode != MP2_LOAD_BLOCKS || options->precision != BLOCKS_DOUBLE)))
+    {
+        snprintf(result->message, sizeof(result->message), "Error: The screening needs -l blocks in double precision and a positive threshold.");
+        result->status = -1;
+        return -1;
+    }
+
+    // The quadrature factorizes the Cholesky vectors, the other modes have no such vectors
+    if (options->laplace_points != 0 &&
+        (options->load_mode != MP2_LOAD_CHOLESKY || options->laplace_points > LAPLACE_MAX_POINTS ||
+         (options->laplace_points < 0 && !(options->laplace_tolerance > 0.0))))
+    {
+        snprintf(result->message, sizeof(result->message), "Error: The Laplace quadrature needs -l cholesky and 1 to %d points.",
+                 LAPLACE_MAX_POINTS);
+        result->status = -1;
+        return -1;
+    }
+
+    //--------------------------------------------------------------------------------//
+    //                     LOADING THE DATA (BINARY CACHE OR TREXIO)                  //
+    //--------------------------------------------------------------------------------//
+
+    // The Cholesky vectors depend on the threshold and are not cached, nor are the single and
+    // mixed precision blocks, the screened ones or the slices; the packed store holds every
+    // integral whatever the frozen core
+    int layout = (options->load_mode == MP2_LOAD_FULL) ? CACHE_LAYOUT_PACKED : CACHE_LAYOUT_BLOCKS;
+    int cache_frozen = (layout == CACHE_LAYOUT_BLOCKS) ? options->n_frozen : 0;
+    mp2_cache_t* cache = &context->cache;
+    memset(cache, 0, sizeof(mp2_cache_t));
+    char cache_path[4096];
+    uint64_t key = 0;
+    phase_start = profile_clock();
+    int use_cache = (options->cache_dir != NULL && options->load_mode != MP2_LOAD_CHOLESKY &&
+                     options->precision == BLOCKS_DOUBLE && options->screening == 0.0 && options->n_ranks <= 1 &&
+                     cache_key_file(input_filename, &key) == 0);
+
+    if (use_cache)
+    {
+        cache_filename(cache_path, sizeof(cache_path), options->cache_dir, input_filename, key, layout, cache_frozen);
+        result->cached = (cache_open(cache, cache_path, key, layout, cache_frozen) == 0);
+
+        // The key only covers the metadata of the input: on request its contents are hashed too,
+        // and a cache that does not match is rewritten
+        uint64_t hash;
+        if (result->cached && options->cache_verify &&
+            (cache_hash_file(input_filename, &hash) != 0 || hash != cache->hash))
+        {
+            cache_close(cache);
+            memset(cache, 0, sizeof(mp2_cache_t));
+            result->cached = 0;
+        }
+    }
+    profile->time[PROFILE_CACHE] += profile_clock() - phase_start;
+
+    if (result->cached)
+    {
+        result->nuclear_repulsion = cache->nuclear_repulsion;
+        result->n_up = cache->n_up;
+        result->mo_num = cache->mo_num;
+        result->n_integrals = cache->n_integrals;
+        if (job_check_frozen(result, options->n_frozen) != 0)
+        {
+            cache_close(cache);
+            return -1;
+        }
+        context->data = cache->data;
+        context->mo_energy = cache->mo_energy;
+        context->eri = &cache->eri;
+        context->blocks = &cache->blocks;
+    }
+    else
+    {
+        if (job_read_trexio(input_filename, options, ws, result) != 0) return -1;
+        context->data = ws->data;
+        context->mo_energy = ws->mo_energy;
+        context->eri = ws->eri;
+        context->blocks = ws->blocks;
+
+        // The hash of the contents, for the later runs that verify the cache, is taken while
+        // the input is still in the page cache
+        if (use_cache && cache_hash_file(input_filename, &cache->hash) == 0)
+        {
+            cache->key = key;
+            cache->layout = layout;
+            cache->nuclear_repulsion = result->nuclear_repulsion;
+            cache->n_up = result->n_up;
+            cache->mo_num = result->mo_num;
+            cache->n_frozen = cache_frozen;
+            cache->n_integrals = result->n_integrals;
+            cache->data = context->data;
+            cache->mo_energy = context->mo_energy;
+            if (options->load_mode == MP2_LOAD_FULL)
+                cache->eri = *context->eri;
+            else
+                cache->blocks = *context->blocks;
+
+            // A cache that cannot be written only costs the next run a TREXIO read
+            phase_start = profile_clock();
+            if (cache_write(cache_path, cache) != 0)
+                printf("Warning: could not write the integral cache %s\n", cache_path);
+            profile->time[PROFILE_CACHE] += profile_clock() - phase_start;
+
+            // Nothing is mapped: the arrays stay those of the workspace
+            memset(cache, 0, sizeof(mp2_cache_t));
+        }
+    }
+
+    result->n_frozen = options->n_frozen;
+    context->loaded = 1;
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to check that a molecule is loaded before a calculation
+static int mp2_check_loaded(mp2_context_t* context)
+{
+    if (context->loaded) return 0;
+
+    if (context->result.status == 0)
+    {
+        snprintf(context->result.message, sizeof(context->result.message), "Error: No molecule loaded.");
+        context->result.status = -1;
+    }
+    return -1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to report a calculation that ran out of memory (the energy functions then return NAN)
+static int mp2_compute_failed(mp2_context_t* context, const char* what)
+{
+    snprintf(context->result.message, sizeof(context->result.message), "Error: Memory allocation failed in the %s calculation.", what);
+    context->result.status = -1;
+    return -1;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the HF energy of the loaded molecule
+// Parameters:
+// - context: Context with a loaded molecule
+// - hf_energy: Receives the energy (may be NULL, it is also kept in the result)
+int mp2_compute_hf(mp2_context_t* context, double* hf_energy)
+{
+    if (mp2_check_loaded(context) != 0) return -1;
+
+    mp2_result_t* result = &context->result;
+    int load_mode = context->options.load_mode;
+    double phase_start = profile_clock();
+
+    if (load_mode == MP2_LOAD_CHOLESKY)
+        result->hf_energy = HF_energy_blocks(result->nuclear_repulsion, context->data, &context->ws.cholesky->occ, result->mo_num);
+    else if (load_mode == MP2_LOAD_FULL)
+        result->hf_energy = HF_energy(result->nuclear_repulsion, context->data, context->eri, result->mo_num, result->n_up);
+    else
+        result->hf_energy = HF_energy_blocks(result->nuclear_repulsion, context->data, context->blocks, result->mo_num);
+
+    result->profile.time[PROFILE_HF] += profile_clock() - phase_start;
+    if (isnan(result->hf_energy)) return mp2_compute_failed(context, "HF");
+    if (hf_energy != NULL) *hf_energy = result->hf_energy;
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to record the tiles kept by the screening and the pairs it skips, with the sum of
+// their energy bounds
+static void mp2_record_screening(mp2_context_t* context)
+{
+    const eri_blocks_t* blocks = context->blocks;
+    mp2_profile_t* profile = &context->result.profile;
+    int n_frozen = blocks->n_frozen;
+    int n_active = blocks->n_occ - n_frozen;
+
+    profile->screening = blocks->screening;
+    profile->tiles_kept = blocks->n_tile_kept;
+    profile->tiles_total = (int64_t) blocks->n_rows * n_active;
+    profile->pairs_skipped = 0;
+    profile->screening_bound = 0.0;
+    for (int i = n_frozen; i < blocks->n_occ; i++)
+    {
+        if (!blocks_has_row(blocks, i)) continue;
+        for (int j = i; j < blocks->n_occ; j++)
+        {
+            double bound = MP2_pair_bound(blocks, context->mo_energy, i, j);
+            if (bound >= blocks->screening) continue;
+            profile->pairs_skipped++;
+            profile->screening_bound += bound;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to record the spin components, operation count and settings of an MP2 calculation
+static void mp2_record(mp2_context_t* context, const mp2_pairs_t* pairs, double* mp2_energy)
+{
+    mp2_result_t* result = &context->result;
+    mp2_profile_t* profile = &result->profile;
+    int load_mode = context->options.load_mode;
+    int n_up = result->n_up;
+
+    profile->mp2_flops += job_mp2_flops(load_mode, n_up - result->n_frozen, result->mo_num - n_up, result->n_cholesky,
+                                        profile->laplace_points, profile->pairs_skipped);
+    profile->kernel = (load_mode == MP2_LOAD_FULL) ? "scalar" : mp2_kernel_name(mp2_kernel_select());
+    profile->precision = job_precision_name(context->options.precision);
+    profile->read_depth = context->options.read_depth;
+    result->mp2_same_spin = pairs->same_spin;
+    result->mp2_opposite_spin = pairs->opposite_spin;
+
+    if (mp2_energy != NULL) *mp2_energy = result->mp2_energy;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the MP2 energy of the loaded molecule, with its spin components
+// Parameters:
+// - context: Context with a loaded molecule
+// - pairs: Receives the pair energies when pairs->pair_energy is allocated
+//          ((n_up - n_frozen)^2 doubles), and the spin components (may be NULL)
+// - mp2_energy: Receives the energy (may be NULL, it is also kept in the result)
+int mp2_compute_mp2(mp2_context_t* context, mp2_pairs_t* pairs, double* mp2_energy)
+{
+    if (mp2_check_loaded(context) != 0) return -1;
+    if (context->options.n_ranks > 1)
+    {
+        snprintf(context->result.message, sizeof(context->result.message),
+                 "Error: A slice needs mp2_compute_pair_sums and mp2_compute_mp2_from_sums.");
+        context->result.status = -1;
+        return -1;
+    }
+
+    mp2_result_t* result = &context->result;
+    mp2_profile_t* profile = &result->profile;
+    int load_mode = context->options.load_mode;
+    int n_up = result->n_up;
+    int n_frozen = result->n_frozen;
+
+    // The spin components come out of the same pass as the energy
+    mp2_pairs_t spin;
+    memset(&spin, 0, sizeof(spin));
+    if (pairs == NULL) pairs = &spin;
+
+    double phase_start = profile_clock();
+    if (load_mode == MP2_LOAD_CHOLESKY && context->options.laplace_points != 0)
+    {
+        // The quadrature is fitted to the range of denominators of the molecule
+        int n_point = (context->options.laplace_points > 0) ? context->options.laplace_points : 0;
+        laplace_quadrature_t quadrature;
+        if (laplace_fit_denominators(context->ws.cholesky, context->mo_energy, n_point, context->options.laplace_tolerance,
+                                     &quadrature) != 0)
+        {
+            snprintf(result->message, sizeof(result->message), "Error: No Laplace quadrature without an orbital gap.");
+            result->status = -1;
+            return -1;
+        }
+        result->mp2_energy = calculate_MP2_energy_laplace(context->ws.cholesky, context->mo_energy, &quadrature, pairs);
+        profile->laplace_points = quadrature.n_point;
+        profile->laplace_error = quadrature.error;
+
+        // Each direct term carries at most this relative error, and the exchange sum is at
+        // most the direct sum in size (Cauchy-Schwarz): |error| <= 3 error |E_OS|
+        profile->laplace_bound = 3.0 * quadrature.error * fabs(pairs->opposite_spin);
+    }
+    else if (load_mode == MP2_LOAD_CHOLESKY)
+        result->mp2_energy = calculate_MP2_energy_cholesky(context->ws.cholesky, context->mo_energy, pairs);
+    else if (load_mode == MP2_LOAD_FULL)
+        result->mp2_energy = calculate_MP2_energy(context->eri, context->mo_energy, n_up, result->mo_num, n_frozen, pairs);
+    else
+        result->mp2_energy = calculate_MP2_energy_blocks(context->blocks, context->mo_energy, pairs);
+    profile->time[PROFILE_MP2] += profile_clock() - phase_start;
+    if (isnan(result->mp2_energy)) return mp2_compute_failed(context, "MP2");
+    if (load_mode == MP2_LOAD_BLOCKS && context->blocks->screening > 0.0) mp2_record_screening(context);
+
+    mp2_record(context, pairs, mp2_energy);
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the direct and exchange sums of the pairs of the slice of a distributed run
+// Each pair (i,j) is summed by the process keeping the row min(i,j) and is zero elsewhere, so
+// that adding the arrays of all the processes gives exactly those of the whole molecule.
+// Parameters:
+// - context: Context with a loaded molecule (blocks load)
+// - direct, exchange: Receive the sums of the (n_up - n_frozen)^2 ordered pairs
+int mp2_compute_pair_sums(mp2_context_t* context, double* direct, double* exchange)
+{
+    if (mp2_check_loaded(context) != 0) return -1;
+    if (context->options.load_mode != MP2_LOAD_BLOCKS)
+    {
+        snprintf(context->result.message, sizeof(context->result.message), "Error: The pair sums need -l blocks.");
+        context->result.status = -1;
+        return -1;
+    }
+
+    double phase_start = profile_clock();
+    int status = MP2_pair_sums_blocks(context->blocks, context->mo_energy, direct, exchange);
+    context->result.profile.time[PROFILE_MP2] += profile_clock() - phase_start;
+    return (status == 0) ? 0 : mp2_compute_failed(context, "MP2");
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the MP2 energy of the loaded molecule from the pair sums of all the slices
+// Parameters:
+// - context: Context with a loaded molecule
+// - direct, exchange: Sums of the (n_up - n_frozen)^2 ordered pairs, added over the slices
+// - pairs: As for mp2_compute_mp2 (may be NULL)
+// - mp2_energy: Receives the energy (may be NULL, it is also kept in the result)
+int mp2_compute_mp2_from_sums(mp2_context_t* context, const double* direct, const double* exchange, mp2_pairs_t* pairs,
+                              double* mp2_energy)
+{
+    if (mp2_check_loaded(context) != 0) return -1;
+
+    mp2_pairs_t spin;
+    memset(&spin, 0, sizeof(spin));
+    if (pairs == NULL) pairs = &spin;
+
+    double phase_start = profile_clock();
+    context->result.mp2_energy = combine_pairs(direct, exchange, context->result.n_up - context->result.n_frozen, pairs);
+    context->result.profile.time[PROFILE_MP2] += profile_clock() - phase_start;
+    if (isnan(context->result.mp2_energy)) return mp2_compute_failed(context, "MP2");
+
+    mp2_record(context, pairs, mp2_energy);
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to get the sizes, energies, timings and status of the molecule of a context
+const mp2_result_t* mp2_context_result(const mp2_context_t* context)
+{
+    return &context->result;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write the report, the profile and (with write_pairs) the pair energies of the
+// molecule of a context next to its input file
+// Parameters:
+// - context: Context whose HF and MP2 energies are computed
+// - pairs: Pair energies of the MP2 calculation
+// - start_time: profile_clock() at the start of the molecule
+void mp2_write_reports(mp2_context_t* context, const mp2_pairs_t* pairs, double start_time)
+{
+    const mp2_options_t* options = &context->options;
+    mp2_result_t* r = &context->result;
+    const char* input_filename = r->input_filename;
+    mp2_profile_t* profile = &r->profile;
+    profile_finish(profile);
+    profile->total_time = profile_clock() - start_time;
+
+    // The report sits next to the input file, with the extension replaced by ".txt"
+    int base_length = (int) (strrchr(input_filename, '.') - input_filename);
+    snprintf(r->output_filename, sizeof(r->output_filename), "%.*s.txt", base_length, input_filename);
+    create_output_file(r->output_filename, input_filename, r->nuclear_repulsion, r->n_up, r->mo_num,
+                       r->hf_energy, r->mp2_energy, profile);
+
+    // The same figures in a JSON file, "<input>.profile.json", for tracking across versions
+    char profile_filename[4096];
+    snprintf(profile_filename, sizeof(profile_filename), "%.*s.profile.json", base_length, input_filename);
+    profile_write_json(profile_filename, input_filename, job_load_mode_name(options->load_mode), r->n_up, r->mo_num,
+                       r->n_frozen, profile);
+
+    // The pair energies go to "<input>.pairs.txt"
+    if (options->write_pairs)
+    {
+        char pairs_filename[4096];
+        snprintf(pairs_filename, sizeof(pairs_filename), "%.*s.pairs.txt", base_length, input_filename);
+        write_pair_energies(pairs_filename, input_filename, r->n_frozen, pairs, r->mp2_energy);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the HF and MP2 energies of one TREXIO file and write its reports
+// Parameters:
+// - context: Context of the calling worker, whose buffers are reused between molecules
+// - input_filename: TREXIO file (.h5)
+// - result: Energies, sizes, timing and status of the calculation
+int mp2_run_file(mp2_context_t* context, const char* input_filename, mp2_result_t* result)
+{
+    double start_time = profile_clock();
+    const mp2_options_t* options = &context->options;
+
+    if (mp2_load(context, input_filename) != 0 || mp2_compute_hf(context, NULL) != 0)
+    {
+        *result = context->result;
+        return -1;
+    }
+
+    int n_active = context->result.n_up - context->result.n_frozen;
+
+    mp2_pairs_t pairs;
+    memset(&pairs, 0, sizeof(pairs));
+    if (options->write_pairs)
+    {
+        pairs.pair_energy = malloc((size_t) n_active * n_active * sizeof(double) + sizeof(double));
+        if (pairs.pair_energy == NULL) mp2_compute_failed(context, "MP2");
+    }
+    if (context->result.status != 0 || mp2_compute_mp2(context, &pairs, NULL) != 0)
+    {
+        // No report for a molecule without an energy
+        free(pairs.pair_energy);
+        mp2_unload(context);
+        *result = context->result;
+        return -1;
+    }
+    mp2_unload(context);
+
+    mp2_write_reports(context, &pairs, start_time);
+    free(pairs.pair_energy);
+
+    context->result.wall_time = profile_clock() - start_time;
+    *result = context->result;
+    return 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,83 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <stdint.h>
+#include "eri.h"
+#include "blocks.h"
+#include "cholesky.h"
+#include "profile.h"
+
+// Storage of the two-electron integrals used by the calculation
+#define MP2_LOAD_BLOCKS   0     // (oo|oo) and (ov|ov) blocks
+#define MP2_LOAD_FULL     1     // Symmetry-packed store of all the unique integrals
+#define MP2_LOAD_CHOLESKY 2     // (oo|oo) block and Cholesky vectors of the (ov|ov) block
+
+// Settings shared by all the molecules of a run
+typedef struct
+{
+    int load_mode;              // MP2_LOAD_BLOCKS, MP2_LOAD_FULL or MP2_LOAD_CHOLESKY
+    int precision;              // Storage of the (ov|ov) block: BLOCKS_DOUBLE, BLOCKS_FLOAT or BLOCKS_MIXED
+    double mixed_threshold;     // Magnitude of the integrals kept in double by BLOCKS_MIXED
+    double screening;           // Magnitude below which the (ov|ov) integrals and pair bounds are dropped (0: none)
+    double cholesky_threshold;  // Largest diagonal left by the Cholesky decomposition
+    int n_frozen;               // Number of lowest occupied orbitals left out of MP2 (frozen core)
+    int write_pairs;            // Also write the pair energies next to the report
+    int64_t memory_budget;      // Bytes allowed for the ERI read buffers (0: default chunk)
+    int read_depth;             // Chunk buffers of the ERI read queue (1: read and fold in turn)
+    int laplace_points;         // Laplace quadrature points of the MP2 denominators (-l cholesky, 0: exact)
+    double laplace_tolerance;   // Or, with laplace_points < 0, largest relative error of the quadrature
+    int rank;                   // Slice of the (ov|ov) block kept: the active rows rank + k n_ranks
+    int n_ranks;                // Number of slices of a distributed run (1: the whole block)
+    const char* cache_dir;      // Directory of the binary integral caches (NULL: no cache)
+    int cache_verify;           // Also hash the whole TREXIO file and check it against the cache
+} mp2_options_t;
+
+// Buffers owned by one worker and reused from one molecule to the next
+typedef struct
+{
+    double* data;               // One-electron integrals
+    int64_t data_capacity;
+    double* mo_energy;          // Orbital energies
+    int64_t mo_energy_capacity;
+    eri_t* eri;                 // Packed integral store (full load only)
+    eri_blocks_t* blocks;       // (oo|oo) and (ov|ov) blocks
+    eri_cholesky_t* cholesky;   // Cholesky vectors (Cholesky load only)
+    eri_buffer_t buffer;        // Chunk buffers of the ERI stream
+} mp2_workspace_t;
+
+// Outcome of the calculation for one molecule
+typedef struct
+{
+    const char* input_filename;
+    char output_filename[4096]; // Per-file report
+    int status;                 // 0 on success
+    char message[256];          // Error description when status != 0
+    double nuclear_repulsion;
+    int32_t n_up;
+    int32_t mo_num;
+    int64_t n_integrals;
+    double hf_energy;
+    double mp2_energy;
+    double mp2_same_spin;       // Same-spin part of the MP2 energy
+    double mp2_opposite_spin;   // Opposite-spin part of the MP2 energy
+    int n_frozen;
+    double wall_time;           // Seconds spent on this molecule
+    int cached;                 // 1 if the integrals came from the binary cache
+    int64_t n_cholesky;         // Number of Cholesky vectors (Cholesky load only)
+    mp2_profile_t profile;      // Phase timings, bytes read and rates
+} mp2_result_t;
+
+// Loaded molecule, integrals and buffers of one user of the library (see mp2.h)
+typedef struct mp2_context mp2_context_t;
+
+// Function to initialise an empty workspace
+void workspace_init(mp2_workspace_t* ws);
+
+// Function to free all the buffers of a workspace
+void workspace_free(mp2_workspace_t* ws);
+
+// Function to compute the HF and MP2 energies of one TREXIO file with the buffers of a context
+// and write its reports. Returns 0 on success; on failure result->message describes the error.
+int mp2_run_file(mp2_context_t* context, const char* input_filename, mp2_result_t* result);
+
+#endif
@@ -0,0 +1,428 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "laplace.h"
+
+// Number of exponent grids tried per scan of the fit, along each end of the grid
+#define LAPLACE_SCAN 20
+
+// Number of points of the interval where the relative error of a quadrature is measured
+#define LAPLACE_CHECK 400
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to solve a linear least-squares problem min |a x - b| by Householder QR
+// Parameters:
+// - a: m x n matrix, row-major, overwritten
+// - b: m right-hand side, overwritten
+// - m, n: Dimensions (m >= n, n <= LAPLACE_MAX_POINTS)
+// - x: Receives the n unknowns
+// Returns -1 if the matrix is numerically rank deficient.
+static int laplace_least_squares(double* a, double* b, int m, int n, double* x)
+{
+    double diagonal[LAPLACE_MAX_POINTS];
+
+    for (int c = 0; c < n; c++)
+    {
+        double norm = 0.0;
+        for (int r = c; r < m; r++) norm += a[r * n + c] * a[r * n + c];
+        norm = sqrt(norm);
+        if (norm == 0.0) return -1;
+
+        // Reflection of the column c onto alpha e_c, v = a[c:, c] - alpha e_c kept in place
+        double alpha = (a[c * n + c] > 0.0) ? -norm : norm;
+        a[c * n + c] -= alpha;
+        double v_norm = 0.0;
+        for (int r = c; r < m; r++) v_norm += a[r * n + c] * a[r * n + c];
+
+        for (int d = c + 1; d < n; d++)
+        {
+            double s = 0.0;
+            for (int r = c; r < m; r++) s += a[r * n + c] * a[r * n + d];
+            s = 2.0 * s / v_norm;
+            for (int r = c; r < m; r++) a[r * n + d] -= s * a[r * n + c];
+        }
+
+        double s = 0.0;
+        for (int r = c; r < m; r++) s += a[r * n + c] * b[r];
+        s = 2.0 * s / v_norm;
+        for (int r = c; r < m; r++) b[r] -= s * a[r * n + c];
+
+        diagonal[c] = alpha;
+    }
+
+    for (int c = n - 1; c >= 0; c--)
+    {
+        if (fabs(diagonal[c]) < 1.0e-14 * fabs(diagonal[0])) return -1;
+        double s = b[c];
+        for (int d = c + 1; d < n; d++) s -= a[c * n + d] * x[d];
+        x[c] = s / diagonal[c];
+    }
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function returning the largest relative error of x sum_k w_k exp(-t_k x) - 1 over [1, ratio]
+static double laplace_error(const double* exponent, const double* weight, int n_point, double ratio)
+{
+    double error = 0.0;
+    for (int s = 0; s < LAPLACE_CHECK; s++)
+    {
+        double x = pow(ratio, (double) s / (LAPLACE_CHECK - 1));
+        double sum = 0.0;
+        for (int k = 0; k < n_point; k++) sum += weight[k] * exp(-exponent[k] * x);
+        double deviation = fabs(x * sum - 1.0);
+        if (deviation > error) error = deviation;
+    }
+    return error;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to fit the weights of given exponents over [1, ratio] and return the largest relative error
+// The weights minimise the squared relative error on points spread evenly in log x. A fit that
+// fails, or runs out of memory, has an infinite error.
+static double laplace_fit_weights(const double* exponent, int n_point, double ratio, double* weight)
+{
+    int m = 32 + 16 * n_point;
+    double* a = malloc((size_t) m * n_point * sizeof(double));
+    double* b = malloc(m * sizeof(double));
+    if (a == NULL || b == NULL)
+    {
+        free(a);
+        free(b);
+        return INFINITY;
+    }
+
+    for (int s = 0; s < m; s++)
+    {
+        double x = pow(ratio, (double) s / (m - 1));
+        for (int k = 0; k < n_point; k++) a[s * n_point + k] = x * exp(-exponent[k] * x);
+        b[s] = 1.0;
+    }
+
+    int status = laplace_least_squares(a, b, m, n_point, weight);
+    free(a);
+    free(b);
+    return (status == 0) ? laplace_error(exponent, weight, n_point, ratio) : INFINITY;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to fit a quadrature of the Laplace transform of 1/x over [x_min, x_max]
+// The exponents form a geometric grid whose two ends are scanned, first coarsely and then
+// around the best pair, the weights of each grid being fitted by least squares; the grid
+// with the smallest largest relative error is kept. The fit is made on [1, x_max / x_min]
+// and scaled back, since exp(-t x / x_min) / x_min has the same relative error.
+// Parameters:
+// - x_min, x_max: Interval of the denominators
+// - n_point: Number of points (1 to LAPLACE_MAX_POINTS)
+// - quadrature: Receives the exponents, weights and largest relative error
+int laplace_fit(double x_min, double x_max, int n_point, laplace_quadrature_t* quadrature)
+{
+    if (!(x_min > 0.0) || x_max < x_min || n_point < 1 || n_point > LAPLACE_MAX_POINTS) return -1;
+
+    double ratio = x_max / x_min;
+    double exponent[LAPLACE_MAX_POINTS];
+    double weight[LAPLACE_MAX_POINTS];
+    double best_error = INFINITY;
+    double best_low = 0.0, best_high = 0.0;
+
+    // Ends of the grid, in log t: the smallest exponent resolves x_max, the largest x = 1
+    // (a single point has only one exponent, scanned over the whole range)
+    double low_min = log(0.005 / ratio), low_max = (n_point > 1) ? log(2.0 / ratio) : log(40.0);
+    double high_min = log(0.3), high_max = log(40.0);
+    int n_high = (n_point > 1) ? LAPLACE_SCAN : 1;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        double low_step = (low_max - low_min) / (LAPLACE_SCAN - 1);
+        double high_step = (n_high > 1) ? (high_max - high_min) / (n_high - 1) : 0.0;
+
+        for (int l = 0; l < LAPLACE_SCAN; l++)
+        {
+            for (int h = 0; h < n_high; h++)
+            {
+                double low = low_min + l * low_step;
+                double high = high_min + h * high_step;
+                for (int k = 0; k < n_point; k++)
+                {
+                    double fraction = (n_point > 1) ? (double) k / (n_point - 1) : 0.0;
+                    exponent[k] = exp(low + fraction * (high - low));
+                }
+
+                double error = laplace_fit_weights(exponent, n_point, ratio, weight);
+                if (error < best_error)
+                {
+                    best_error = error;
+                    best_low = low;
+                    best_high = high;
+                }
+            }
+        }
+
+        // Second pass around the best grid, two coarse steps on each side
+        low_min = best_low - 2.0 * low_step;
+        low_max = best_low + 2.0 * low_step;
+        high_min = best_high - 2.0 * high_step;
+        high_max = best_high + 2.0 * high_step;
+    }
+    if (!isfinite(best_error)) return -1;
+
+    // Weights of the best grid, scaled back from [1, ratio] to [x_min, x_max]
+    for (int k = 0; k < n_point; k++)
+    {
+        double fraction = (n_point > 1) ? (double) k / (n_point - 1) : 0.0;
+        exponent[k] = exp(best_low + fraction * (best_high - best_low));
+    }
+    quadrature->error = laplace_fit_weights(exponent, n_point, ratio, weight);
+    if (!isfinite(quadrature->error)) return -1;
+    quadrature->n_point = n_point;
+    for (int k = 0; k < n_point; k++)
+    {
+        quadrature->exponent[k] = exponent[k] / x_min;
+        quadrature->weight[k] = weight[k] / x_min;
+    }
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to fit the quadrature with the fewest points whose relative error is below tolerance
+// Parameters:
+// - x_min, x_max: Interval of the denominators
+// - tolerance: Largest relative error accepted
+// - quadrature: Receives the quadrature (that of LAPLACE_MAX_POINTS points if none is below tolerance)
+int laplace_fit_tolerance(double x_min, double x_max, double tolerance, laplace_quadrature_t* quadrature)
+{
+    for (int n_point = 1; n_point <= LAPLACE_MAX_POINTS; n_point++)
+    {
+        if (laplace_fit(x_min, x_max, n_point, quadrature) != 0) return -1;
+        if (quadrature->error <= tolerance) break;
+    }
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to fit the quadrature of the MP2 denominators e_a + e_b - e_i - e_j of a decomposition
+// Parameters:
+// - cholesky: Decomposition (for the active and virtual orbitals)
+// - mo_energy: Molecular orbital energies
+// - n_point: Number of points (0: the fewest points below tolerance)
+// - tolerance: Largest relative error of the denominators when n_point is 0
+// - quadrature: Receives the quadrature
+int laplace_fit_denominators(const eri_cholesky_t* cholesky, const double* mo_energy, int n_point, double tolerance,
+                             laplace_quadrature_t* quadrature)
+{
+    int n_occ = cholesky->n_occ;
+    int n_orbital = n_occ + cholesky->n_virt;
+    if (n_occ <= cholesky->n_frozen || cholesky->n_virt <= 0) return -1;
+
+    double occ_min = mo_energy[cholesky->n_frozen], occ_max = occ_min;
+    for (int i = cholesky->n_frozen; i < n_occ; i++)
+    {
+        if (mo_energy[i] < occ_min) occ_min = mo_energy[i];
+        if (mo_energy[i] > occ_max) occ_max = mo_energy[i];
+    }
+    double virt_min = mo_energy[n_occ], virt_max = virt_min;
+    for (int a = n_occ; a < n_orbital; a++)
+    {
+        if (mo_energy[a] < virt_min) virt_min = mo_energy[a];
+        if (mo_energy[a] > virt_max) virt_max = mo_energy[a];
+    }
+
+    double x_min = 2.0 * (virt_min - occ_max);
+    double x_max = 2.0 * (virt_max - occ_min);
+    if (n_point > 0) return laplace_fit(x_min, x_max, n_point, quadrature);
+    return laplace_fit_tolerance(x_min, x_max, tolerance, quadrature);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the n_vec x n_vec product g[K][L] = sum_a x[K][a] y[L][a] of two
+// orbital blocks of weighted vectors (n_vec x n_virt each)
+// Four columns L are accumulated at once so that each row x[K] is loaded once for them.
+static void laplace_gram(const double* x, const double* y, int64_t n_vec, int64_t n_virt, double* g)
+{
+    for (int64_t k = 0; k < n_vec; k++)
+    {
+        const double* restrict x_k = x + k * n_virt;
+        int64_t l = 0;
+        for (; l + 4 <= n_vec; l += 4)
+        {
+            const double* restrict y_0 = y + l * n_virt;
+            const double* restrict y_1 = y_0 + n_virt;
+            const double* restrict y_2 = y_1 + n_virt;
+            const double* restrict y_3 = y_2 + n_virt;
+            double s_0 = 0.0, s_1 = 0.0, s_2 = 0.0, s_3 = 0.0;
+            for (int64_t a = 0; a < n_virt; a++)
+            {
+                s_0 += x_k[a] * y_0[a];
+                s_1 += x_k[a] * y_1[a];
+                s_2 += x_k[a] * y_2[a];
+                s_3 += x_k[a] * y_3[a];
+            }
+            g[k * n_vec + l + 0] = s_0;
+            g[k * n_vec + l + 1] = s_1;
+            g[k * n_vec + l + 2] = s_2;
+            g[k * n_vec + l + 3] = s_3;
+        }
+        for (; l < n_vec; l++)
+        {
+            const double* restrict y_l = y + l * n_virt;
+            double s = 0.0;
+            for (int64_t a = 0; a < n_virt; a++) s += x_k[a] * y_l[a];
+            g[k * n_vec + l] = s;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to calculate the MP2 energy correction with Laplace-transformed denominators
+// At each point t of the quadrature, exp(-t (e_a + e_b - e_i - e_j)) splits into orbital
+// weights, folded into the vectors: W_K(ia) = L_K(ia) exp(-t (e_a - e_i) / 2). With the
+// n_vec x n_vec products G_ij = W_i W_j^T of the orbital blocks, the sums of a pair become
+//     sum_ab <ij|ab>^2 exp(-t D)      = <G_ii, G_jj>   (Frobenius product)
+//     sum_ab <ij|ab> <ij|ba> exp(-t D) = sum_KL G_ij[K][L] G_ij[L][K]
+// so the work is made of products of n_vec x n_virt matrices, n_vec^2 n_virt per pair and
+// point instead of n_vec n_virt^2 per pair for the tiles: cheaper for large virtual spaces.
+// Parameters:
+// - cholesky: Cholesky decomposition of the (ia|jb) integrals
+// - mo_energy: Molecular orbital energies
+// - quadrature: Quadrature of the denominators (see laplace_fit_denominators)
+// - pairs: Receives the pair energies and spin components (may be NULL)
+double calculate_MP2_energy_laplace(const eri_cholesky_t* cholesky, const double* mo_energy,
+                                    const laplace_quadrature_t* quadrature, mp2_pairs_t* pairs)
+{
+    int n_frozen = cholesky->n_frozen;
+    int n_active = cholesky->n_occ - n_frozen;
+    int64_t n_virt = cholesky->n_virt;
+    int64_t n_vec = cholesky->n_vec;
+    const double* virt_energy = mo_energy + cholesky->n_occ;
+
+    int n_pair = n_active * (n_active + 1) / 2;
+    size_t n_ordered = (size_t) n_active * n_active;
+    size_t block = (size_t) n_vec * n_virt;
+    size_t gram = (size_t) n_vec * n_vec;
+    double* direct = calloc(n_ordered > 0 ? n_ordered : 1, sizeof(double));
+    double* exchange = calloc(n_ordered > 0 ? n_ordered : 1, sizeof(double));
+    double* weighted = malloc((n_active * block > 0 ? n_active * block : 1) * sizeof(double));
+    double* diagonal = malloc((n_active * gram > 0 ? n_active * gram : 1) * sizeof(double));
+    double* virt_weight = malloc((n_virt > 0 ? n_virt : 1) * sizeof(double));
+    int* pair_i = malloc((n_pair > 0 ? n_pair : 1) * sizeof(int));
+    int* pair_j = malloc((n_pair > 0 ? n_pair : 1) * sizeof(int));
+    double energy_mp2 = NAN;
+    if (direct == NULL || exchange == NULL || weighted == NULL || diagonal == NULL || virt_weight == NULL ||
+        pair_i == NULL || pair_j == NULL) goto cleanup;
+
+    int n_p = 0;
+    for (int i = 0; i < n_active; i++)
+    {
+        for (int j = i; j < n_active; j++)
+        {
+            pair_i[n_p] = i;
+            pair_j[n_p] = j;
+            n_p++;
+        }
+    }
+
+    for (int point = 0; point < quadrature->n_point; point++)
+    {
+        double t = quadrature->exponent[point];
+        double w = quadrature->weight[point];
+        for (int64_t a = 0; a < n_virt; a++) virt_weight[a] = exp(-0.5 * t * virt_energy[a]);
+
+        // Weighted vectors and G_ii of every active orbital
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < n_active; i++)
+        {
+            const double* l_i = cholesky_vectors(cholesky, n_frozen + i);
+            double* w_i = weighted + i * block;
+            double occ_weight = exp(0.5 * t * mo_energy[n_frozen + i]);
+            for (int64_t k = 0; k < n_vec; k++)
+            {
+                for (int64_t a = 0; a < n_virt; a++)
+                {
+                    w_i[k * n_virt + a] = l_i[k * n_virt + a] * occ_weight * virt_weight[a];
+                }
+            }
+            laplace_gram(w_i, w_i, n_vec, n_virt, diagonal + i * gram);
+        }
+
+        // Each pair is only updated by one thread, in the order of the points; a thread without
+        // its buffer still takes part in the loop, but skips its pairs
+        int failed = 0;
+        #pragma omp parallel
+        {
+            double* g_ij = malloc((gram > 0 ? gram : 1) * sizeof(double));
+            if (g_ij == NULL)
+            {
+                #pragma omp atomic write
+                failed = 1;
+            }
+
+            #pragma omp for schedule(dynamic)
+            for (int p = 0; p < n_pair; p++)
+            {
+                if (g_ij == NULL) continue;
+                int i = pair_i[p];
+                int j = pair_j[p];
+                const double* g_ii = diagonal + i * gram;
+                const double* g_jj = diagonal + j * gram;
+
+                const double* g = g_ii;
+                if (i != j)
+                {
+                    laplace_gram(weighted + i * block, weighted + j * block, n_vec, n_virt, g_ij);
+                    g = g_ij;
+                }
+
+                double sum_direct = 0.0;
+                double sum_exchange = 0.0;
+                for (int64_t k = 0; k < n_vec; k++)
+                {
+                    for (int64_t l = 0; l < n_vec; l++)
+                    {
+                        sum_direct += g_ii[k * n_vec + l] * g_jj[k * n_vec + l];
+                        sum_exchange += g[k * n_vec + l] * g[l * n_vec + k];
+                    }
+                }
+
+                // The denominators e_i + e_j - e_a - e_b are negative
+                direct[i * n_active + j] -= w * sum_direct;
+                exchange[i * n_active + j] -= w * sum_exchange;
+            }
+
+            free(g_ij);
+        }
+        if (failed) goto cleanup;
+    }
+
+    // The pair (j,i) has the same sums
+    for (int i = 0; i < n_active; i++)
+    {
+        for (int j = i + 1; j < n_active; j++)
+        {
+            direct[j * n_active + i] = direct[i * n_active + j];
+            exchange[j * n_active + i] = exchange[i * n_active + j];
+        }
+    }
+
+    energy_mp2 = combine_pairs(direct, exchange, n_active, pairs);
+
+cleanup:
+    free(direct);
+    free(exchange);
+    free(weighted);
+    free(diagonal);
+    free(virt_weight);
+    free(pair_i);
+    free(pair_j);
+
+    return energy_mp2;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#ifndef LAPLACE_H
+#define LAPLACE_H
+
+#include "cholesky.h"
+#include "utils.h"
+
+// Largest number of quadrature points
+#define LAPLACE_MAX_POINTS 12
+
+// Quadrature of the Laplace transform 1/x = int_0^inf exp(-x t) dt, valid over [x_min, x_max]:
+// 1/x ~ sum_k weight_k exp(-exponent_k x). The MP2 denominators e_a + e_b - e_i - e_j all lie
+// in such an interval, so that each point factorizes them into orbital weights.
+typedef struct
+{
+    int n_point;
+    double exponent[LAPLACE_MAX_POINTS];
+    double weight[LAPLACE_MAX_POINTS];
+    double error;       // Largest relative error of the quadrature over the interval
+} laplace_quadrature_t;
+
+// Function to fit a quadrature of n_point points for 1/x over [x_min, x_max] (0 < x_min <= x_max).
+// Returns 0 on success, -1 for an invalid interval or number of points.
+int laplace_fit(double x_min, double x_max, int n_point, laplace_quadrature_t* quadrature);
+
+// Function to fit the quadrature with the fewest points whose relative error is below tolerance
+// (LAPLACE_MAX_POINTS if none is). Returns 0 on success, -1 for an invalid interval.
+int laplace_fit_tolerance(double x_min, double x_max, double tolerance, laplace_quadrature_t* quadrature);
+
+// Function to fit the quadrature of the MP2 denominators of a decomposition, with n_point points,
+// or with the fewest points below tolerance when n_point is 0. Returns -1 without an orbital gap.
+int laplace_fit_denominators(const eri_cholesky_t* cholesky, const double* mo_energy, int n_point, double tolerance,
+                             laplace_quadrature_t* quadrature);
+
+// Function to calculate the MP2 energy correction from the Cholesky vectors with the
+// Laplace-transformed denominators of a quadrature (NAN if memory runs out)
+double calculate_MP2_energy_laplace(const eri_cholesky_t* cholesky, const double* mo_energy,
+                                    const laplace_quadrature_t* quadrature, mp2_pairs_t* pairs);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MP2_H
+#define MP2_H
+
+#include "job.h"
+#include "utils.h"
+
+// Library interface of the HF and MP2 calculations (libmp2.a, libmp2.so)
+//
+// A context owns the integrals, orbital energies and buffers of one molecule at a time.
+// Once a TREXIO file is loaded, HF and MP2 can be computed any number of times without
+// reading it again, and loading the next molecule reuses the buffers when they are large
+// enough. A context is used by one thread at a time; several contexts can run concurrently.
+//
+//     mp2_context_t* context = mp2_context_create(NULL);
+//     if (mp2_load(context, "data/hcn.h5") == 0)
+//     {
+//         double hf, mp2;
+//         mp2_compute_hf(context, &hf);
+//         mp2_compute_mp2(context, NULL, &mp2);
+//     }
+//     else printf("%s\n", mp2_context_result(context)->message);
+//     mp2_context_free(context);
+
+// Function to set the default options (blocks in double precision, no frozen core, no cache)
+void mp2_options_default(mp2_options_t* options);
+
+// Function to create a context with its own buffers (options NULL for the defaults).
+// Returns NULL if the allocation fails.
+mp2_context_t* mp2_context_create(const mp2_options_t* options);
+
+// Function to free a context and all its buffers
+void mp2_context_free(mp2_context_t* context);
+
+// Function to load the integrals of a TREXIO file (.h5) into a context, replacing the previous
+// molecule. The file name must outlive the results. Returns 0 on success, -1 on failure.
+int mp2_load(mp2_context_t* context, const char* input_filename);
+
+// Function to compute the HF energy of the loaded molecule (hf_energy may be NULL).
+// Returns 0 on success, -1 if no molecule is loaded or memory runs out.
+int mp2_compute_hf(mp2_context_t* context, double* hf_energy);
+
+// Function to compute the MP2 energy of the loaded molecule (mp2_energy may be NULL), with
+// its same-spin and opposite-spin parts and, when pairs->pair_energy holds (n_up - n_frozen)^2
+// doubles, the pair energies (pairs may be NULL). Returns 0 on success, -1 on failure.
+int mp2_compute_mp2(mp2_context_t* context, mp2_pairs_t* pairs, double* mp2_energy);
+
+// Function to get the sizes, energies, timings and status (message on failure) of the context
+const mp2_result_t* mp2_context_result(const mp2_context_t* context);
+
+// Function to write the report, profile and (with write_pairs) pair energies of the molecule
+// next to its input file, as mp2_energy does. start_time is profile_clock() at the start.
+void mp2_write_reports(mp2_context_t* context, const mp2_pairs_t* pairs, double start_time);
+
+// Distributed runs (see mp2_mpi.c): with options rank and n_ranks, each context keeps only the
+// active rows rank, rank + n_ranks, ... of the (ov|ov) block (-l blocks only). The pair sums of
+// the slices are added over the processes before the MP2 energy is finished from them.
+//
+//     mp2_compute_pair_sums(context, direct, exchange);
+//     MPI_Reduce(direct, ...); MPI_Reduce(exchange, ...);
+//     mp2_compute_mp2_from_sums(context, direct_total, exchange_total, NULL, &mp2);
+
+// Function to compute the direct and exchange sums of the (n_up - n_frozen)^2 ordered pairs of
+// the slice, zero for the pairs of the other slices. Returns 0 on success, -1 on failure.
+int mp2_compute_pair_sums(mp2_context_t* context, double* direct, double* exchange);
+
+// Function to compute the MP2 energy of the loaded molecule from the pair sums added over all
+// the slices (pairs and mp2_energy as for mp2_compute_mp2). Returns 0 on success, -1 on failure.
+int mp2_compute_mp2_from_sums(mp2_context_t* context, const double* direct, const double* exchange, mp2_pairs_t* pairs,
+                              double* mp2_energy);
+
+#endif
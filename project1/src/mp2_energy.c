@@ -1,229 +1,281 @@
 #include <stdio.h>
-#include <trexio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "utils.h"
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "mp2.h"
+#include "batch.h"
+#include "laplace.h"
+
+// Function to convert the name of a load mode, returns -1 if it is unknown
+static int parse_load_mode(const char* name)
+{
+    if (strcmp(name, "blocks") == 0) return MP2_LOAD_BLOCKS;
+    if (strcmp(name, "full") == 0) return MP2_LOAD_FULL;
+    if (strcmp(name, "cholesky") == 0) return MP2_LOAD_CHOLESKY;
+    return -1;
+}
+
+// Function to convert the name of a storage precision, returns -1 if it is unknown
+static int parse_precision(const char* name)
+{
+    if (strcmp(name, "double") == 0) return BLOCKS_DOUBLE;
+    if (strcmp(name, "float") == 0) return BLOCKS_FLOAT;
+    if (strcmp(name, "mixed") == 0) return BLOCKS_MIXED;
+    return -1;
+}
+
+// Function to read the Laplace quadrature option: a number of points, or a relative error below 1
+static void parse_laplace(const char* value, mp2_options_t* options)
+{
+    double number = atof(value);
+    if (number > 0.0 && number < 1.0)
+    {
+        options->laplace_points = -1;
+        options->laplace_tolerance = number;
+    }
+    else
+    {
+        options->laplace_points = (number >= 1.0) ? atoi(value) : LAPLACE_MAX_POINTS + 1;
+    }
+}
+
+// Function to append a copy of path to the list of inputs, returns -1 if memory runs out
+static int add_input(char*** inputs, int* n_inputs, const char* path)
+{
+    char** grown = realloc(*inputs, (*n_inputs + 1) * sizeof(char*));
+    if (grown == NULL) return -1;
+    *inputs = grown;
+
+    char* copy = strdup(path);
+    if (copy == NULL) return -1;
+    (*inputs)[(*n_inputs)++] = copy;
+    return 0;
+}
 
 //--------------------------------------------------------------------------------//
 //                                 MAIN PROGRAM                                   //
 //--------------------------------------------------------------------------------//
 
-int main() 
+static void usage(const char* program)
 {
-    trexio_exit_code rc;
-    double energy;
-    int32_t n_up;
-    int32_t mo_num;
-    int64_t n_integrals;
+    printf("Usage: %s [options] [file.h5 ...]\n", program);
+    printf("  -f manifest   read the input files from a list (one path per line)\n");
+    printf("  -j workers    number of molecules processed concurrently (default 1)\n");
+    printf("  -t threads    OpenMP threads per molecule (default: OMP_NUM_THREADS)\n");
+    printf("  -o summary    write a summary of all the molecules (.csv or .json)\n");
+    printf("  -l mode       integrals kept in memory: blocks (default), full or cholesky\n");
+    printf("  -P precision  storage of the (ov|ov) block with -l blocks: double (default), float or\n");
+    printf("                mixed (float, integrals above MP2_MIXED_THRESHOLD or %.0e in double)\n", BLOCKS_MIXED_THRESHOLD);
+    printf("  -s threshold  with -l blocks -P double, drop the (ov|ov) integrals below threshold, keep\n");
+    printf("                only the tiles holding some, and skip the pairs bounded below threshold\n");
+    printf("  -L points     Laplace quadrature of the MP2 denominators with -l cholesky: a number of\n");
+    printf("                points (1 to %d), or a value below 1 for the largest relative error\n", LAPLACE_MAX_POINTS);
+    printf("  -F count      number of lowest occupied orbitals kept frozen in MP2 (default 0)\n");
+    printf("  -p            also write the MP2 pair energies (file.pairs.txt)\n");
+    printf("  -d threshold  threshold of the Cholesky decomposition (default %.0e)\n", CHOLESKY_THRESHOLD_DEFAULT);
+    printf("  -m MB         memory for the integral read buffers, shared by the read queue\n");
+    printf("                (default: MP2_CHUNK_MB or 24 MB per buffer)\n");
+    printf("  -q depth      chunk buffers read ahead of the unpacking, 1 to read and unpack in turn\n");
+    printf("                (default: MP2_READ_DEPTH or %d)\n", ERI_DEPTH_DEFAULT);
+    printf("  -c dir        map the integrals from binary caches in dir, writing them on first use\n");
+    printf("                (default: MP2_CACHE_DIR)\n");
+    printf("  -V            check each cache against a hash of the whole input file before using it\n");
+    printf("                (default: MP2_CACHE_VERIFY, otherwise only its size, time and inode)\n");
+    printf("Without input files, data/hcn.h5 is processed.\n");
+}
 
+int main(int argc, char** argv)
+{
     //--------------------------------------------------------------------------------//
-    //                                 OPENING FILE                                   //
+    //                               COMMAND LINE OPTIONS                             //
     //--------------------------------------------------------------------------------//
-    
-    const char* input_filename = "data/hcn.h5";
-    // Check if the filename has the .h5 extension
-    const char *extension = strrchr(input_filename, '.');
-    if (extension == NULL || strcmp(extension, ".h5") != 0) 
+
+    mp2_options_t options;
+    mp2_options_default(&options);
+
+    // Defaults from the environment, overridden by the options below
+    const char* load_mode = getenv("MP2_LOAD");
+    if (load_mode != NULL) options.load_mode = parse_load_mode(load_mode);
+    const char* frozen_core = getenv("MP2_FROZEN_CORE");
+    if (frozen_core != NULL) options.n_frozen = atoi(frozen_core);
+    const char* chunk_mb = getenv("MP2_CHUNK_MB");
+    if (chunk_mb != NULL) options.memory_budget = (int64_t) (atof(chunk_mb) * 1024 * 1024);
+    options.cache_dir = getenv("MP2_CACHE_DIR");
+    const char* cache_verify = getenv("MP2_CACHE_VERIFY");
+    if (cache_verify != NULL) options.cache_verify = atoi(cache_verify);
+    const char* precision = getenv("MP2_PRECISION");
+    if (precision != NULL) options.precision = parse_precision(precision);
+    const char* mixed_threshold = getenv("MP2_MIXED_THRESHOLD");
+    if (mixed_threshold != NULL) options.mixed_threshold = atof(mixed_threshold);
+    const char* screening = getenv("MP2_SCREENING");
+    if (screening != NULL) options.screening = atof(screening);
+    const char* laplace = getenv("MP2_LAPLACE");
+    if (laplace != NULL) parse_laplace(laplace, &options);
+    const char* read_depth = getenv("MP2_READ_DEPTH");
+    if (read_depth != NULL) options.read_depth = atoi(read_depth);
+
+    char** inputs = NULL;
+    int n_inputs = 0;
+    int n_workers = 1;
+    int n_threads = 0;
+    const char* summary_filename = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:j:t:o:l:P:L:s:d:F:pm:q:c:Vh")) != -1)
     {
-        printf("Error: Input file must have a .h5 extension.\n");
-        return -1;
+        switch (opt)
+        {
+            case 'f':
+                n_inputs = batch_read_manifest(optarg, &inputs, n_inputs);
+                if (n_inputs < 0)
+                {
+                    printf("Error: Could not read the manifest %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'j':
+                n_workers = atoi(optarg);
+                break;
+            case 't':
+                n_threads = atoi(optarg);
+                break;
+            case 'o':
+                summary_filename = optarg;
+                break;
+            case 'l':
+                options.load_mode = parse_load_mode(optarg);
+                break;
+            case 'P':
+                options.precision = parse_precision(optarg);
+                break;
+            case 'L':
+                parse_laplace(optarg, &options);
+                break;
+            case 's':
+                options.screening = atof(optarg);
+                break;
+            case 'F':
+                options.n_frozen = atoi(optarg);
+                break;
+            case 'p':
+                options.write_pairs = 1;
+                break;
+            case 'd':
+                options.cholesky_threshold = atof(optarg);
+                break;
+            case 'm':
+                options.memory_budget = (int64_t) (atof(optarg) * 1024 * 1024);
+                break;
+            case 'q':
+                options.read_depth = atoi(optarg);
+                break;
+            case 'c':
+                options.cache_dir = optarg;
+                break;
+            case 'V':
+                options.cache_verify = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : -1;
+        }
     }
 
-    trexio_t* file = trexio_open(input_filename, 'r', TREXIO_AUTO, &rc);
-    if (rc != TREXIO_SUCCESS) 
+    if (options.load_mode < 0)
     {
-        printf("TREXIO Error: %s\n", trexio_string_of_error(rc));
-        exit(1);
+        printf("Error: Unknown load mode (blocks, full or cholesky)\n");
+        return -1;
     }
-
-    //--------------------------------------------------------------------------------//
-    //                        READING NUCLEAR REPULSION ENERGY                        //
-    //--------------------------------------------------------------------------------//
-    printf("READING THE DATA in progess . . .");
-    rc = trexio_read_nucleus_repulsion(file, &energy);
-    if (rc != TREXIO_SUCCESS) 
+    if (options.precision < 0)
     {
-        printf("TREXIO Error reading nuclear repulsion energy:\n%s\n", trexio_string_of_error(rc));
-        trexio_close(file);
-        exit(1);
+        printf("Error: Unknown precision (double, float or mixed)\n");
+        return -1;
     }
-
-    //--------------------------------------------------------------------------------//
-    //                        OBTAINING THE NUMBER OF OCCUPIED ORBITALS               //
-    //--------------------------------------------------------------------------------//
-
-    rc = trexio_read_electron_up_num(file, &n_up);
-    if (rc != TREXIO_SUCCESS) 
+    if (options.precision != BLOCKS_DOUBLE && options.load_mode != MP2_LOAD_BLOCKS)
     {
-        printf("TREXIO Error reading number of up-spin electrons:\n%s\n", trexio_string_of_error(rc));
-        trexio_close(file);
-        exit(1);
+        printf("Error: Single and mixed precision are only available with -l blocks\n");
+        return -1;
     }
-
-    //--------------------------------------------------------------------------------//
-    //                          READING THE NUMBER OF MOLECULAR ORBITALS              //
-    //--------------------------------------------------------------------------------//
-
-    rc = trexio_read_mo_num(file, &mo_num);
-    if (rc != TREXIO_SUCCESS) 
+    if (options.n_frozen < 0)
     {
-        printf("TREXIO Error reading number of molecular orbitals:\n%s\n", trexio_string_of_error(rc));
-        trexio_close(file);
-        exit(1);
+        printf("Error: The number of frozen orbitals cannot be negative\n");
+        return -1;
     }
-
-    //--------------------------------------------------------------------------------//
-    //                          READING ONE-ELECTRON INTEGRALS                        //
-    //--------------------------------------------------------------------------------//
-
-    double* data = malloc(mo_num * mo_num * sizeof(double));
-    if (data == NULL) 
+    if (options.screening < 0.0 || (options.screening > 0.0 && (options.load_mode != MP2_LOAD_BLOCKS ||
+                                                                options.precision != BLOCKS_DOUBLE)))
     {
-        printf("Memory allocation failed for one-electron integrals!\n");
-        trexio_close(file);
-        exit(1);
+        printf("Error: The screening threshold is positive and only available with -l blocks -P double\n");
+        return -1;
     }
-
-    rc = trexio_read_mo_1e_int_core_hamiltonian(file, data);
-    if (rc != TREXIO_SUCCESS) 
+    if (options.laplace_points > LAPLACE_MAX_POINTS || (options.laplace_points < 0 && !(options.laplace_tolerance > 0.0)))
     {
-        printf("TREXIO Error reading one-electron integrals:\n%s\n", trexio_string_of_error(rc));
-        free(data);
-        trexio_close(file);
-        exit(1);
+        printf("Error: The Laplace quadrature takes 1 to %d points or a tolerance below 1\n", LAPLACE_MAX_POINTS);
+        return -1;
     }
-
-    //--------------------------------------------------------------------------------//
-    //                          READING TWO-ELECTRON INTEGRALS SIZE                   //
-    //--------------------------------------------------------------------------------//
-
-    rc = trexio_read_mo_2e_int_eri_size(file, &n_integrals);
-    if (rc != TREXIO_SUCCESS) 
+    if (options.laplace_points != 0 && options.load_mode != MP2_LOAD_CHOLESKY)
     {
-        printf("TREXIO Error reading two-electron integrals size:\n%s\n", trexio_string_of_error(rc));
-        free(data);
-        trexio_close(file);
-        exit(1);
+        printf("Error: The Laplace quadrature is only available with -l cholesky\n");
+        return -1;
     }
-
-    //--------------------------------------------------------------------------------//
-    //                          READING TWO-ELECTRON INTEGRALS                        //
-    //--------------------------------------------------------------------------------//
-
-    int32_t* const index = malloc(4 * n_integrals * sizeof(int32_t));
-    double* const value = malloc(n_integrals * sizeof(double));
-    if (index == NULL || value == NULL) 
+    if (options.read_depth < 1 || options.read_depth > ERI_DEPTH_MAX)
     {
-        printf("Memory allocation failed for two-electron integrals!\n");
-        free(data);
-        if (index) free(index);
-        if (value) free(value);
-        trexio_close(file);
-        exit(1);
+        printf("Error: The read queue depth must be between 1 and %d\n", ERI_DEPTH_MAX);
+        return -1;
     }
-
-    rc = trexio_read_mo_2e_int_eri(file, 0, &n_integrals, index, value);
-    if (rc != TREXIO_SUCCESS) 
+    if (options.cholesky_threshold <= 0.0)
     {
-        printf("TREXIO Error reading two-electron integrals:\n%s\n", trexio_string_of_error(rc));
-        free(data);
-        free(index);
-        free(value);
-        trexio_close(file);
-        exit(1);
+        printf("Error: The Cholesky threshold must be positive\n");
+        return -1;
     }
 
-    //--------------------------------------------------------------------------------//
-    //                         READING THE INTEGRAL VALUES                            //
-    //--------------------------------------------------------------------------------//
-
-    double ****integral_array = malloc_4d(mo_num, mo_num, mo_num, mo_num);
-
-    for (int n = 0; n < n_integrals; n++) 
+    // Remaining arguments are input files
+    int status = 0;
+    for (int n = optind; n < argc && status == 0; n++) status = add_input(&inputs, &n_inputs, argv[n]);
+    if (status == 0 && n_inputs == 0) status = add_input(&inputs, &n_inputs, "data/hcn.h5");
+    if (status != 0)
     {
-        int i = index[4 * n + 0];
-        int j = index[4 * n + 1];
-        int k = index[4 * n + 2];
-        int l = index[4 * n + 3];
-
-        // The integral values considering the 8-fold symmetry
-        integral_array[i][j][k][l] = value[n];
-        integral_array[k][l][i][j] = value[n];
-        integral_array[k][j][i][l] = value[n];
-        integral_array[i][l][k][j] = value[n];
-        integral_array[j][i][l][k] = value[n];
-        integral_array[l][k][j][i] = value[n];
-        integral_array[j][k][l][i] = value[n];
-        integral_array[l][i][j][k] = value[n];
+        printf("Memory allocation failed for the input files!\n");
+        for (int n = 0; n < n_inputs; n++) free(inputs[n]);
+        free(inputs);
+        return -1;
     }
 
+#ifdef _OPENMP
+    if (n_threads > 0) omp_set_num_threads(n_threads);
+#else
+    if (n_threads > 1) printf("Warning: built without OpenMP, running on a single thread (use make omp).\n");
+#endif
+
     //--------------------------------------------------------------------------------//
-    //                         READING THE ORBITAL ENERGIES                           //
+    //                          PROCESSING THE MOLECULES                              //
     //--------------------------------------------------------------------------------//
 
-    double* mo_energy = malloc(mo_num * sizeof(double));
-    if (mo_energy == NULL)
+    mp2_result_t* results = calloc(n_inputs, sizeof(mp2_result_t));
+    if (results == NULL)
     {
-        printf("Memory allocation failed for orbital energies!\n");
-        free(data);
-        free(index);
-        free(value);
-        trexio_close(file);
-	return -1;
+        printf("Memory allocation failed for the results!\n");
+        return -1;
     }
 
-    rc = trexio_read_mo_energy(file, mo_energy);
-    if (rc != TREXIO_SUCCESS)
-    {
-        printf("TREXIO Error reading molecular orbital energies:\n%s\n",trexio_string_of_error(rc));
-	exit(1);
-    }
+    printf("Processing %d file%s with %d worker%s . . .\n", n_inputs, (n_inputs > 1) ? "s" : "",
+           (n_workers > 1) ? n_workers : 1, (n_workers > 1) ? "s" : "");
+    int n_failed = batch_run(inputs, n_inputs, n_workers, &options, results);
 
-    //--------------------------------------------------------------------------------//
-    //                          CALCULATING THE HARTREE FOCK ENERGY                   //
-    //--------------------------------------------------------------------------------//
+    if (summary_filename != NULL && batch_write_summary(summary_filename, results, n_inputs) == 0)
+        printf("Summary written to %s\n", summary_filename);
 
-    double hf_energy = HF_energy(energy, data, integral_array, mo_num, n_up);
+    printf("\nCalculation completed: %d succeeded, %d failed\n", n_inputs - n_failed, n_failed);
 
-    //--------------------------------------------------------------------------------//
-    //                          CALCULATING THE MP2 ENERGY                            //
-    //--------------------------------------------------------------------------------//
-
-    double mp2_energy = calculate_MP2_energy(integral_array, mo_energy, n_up, mo_num);
- 
-    //--------------------------------------------------------------------------------//
-    //                          WRITING THE OUTPUT FILE                               //
-    //--------------------------------------------------------------------------------//
-    
-    // Dynamically create the output file name
-    char output_file[100];                                              // Assuming max file name length is 100
-    strncpy(output_file, input_filename, sizeof(output_file));
-    char* dot = strrchr(output_file, '.');                              // Find the last dot in the file name
-    if (dot != NULL)
-            *dot = '\0';                                                // Remove the extension
-    strcat(output_file, ".txt");                                        // Append ".txt"
-									
-    // Create output file
-    create_output_file(output_file, input_filename, energy, n_up, mo_num, hf_energy, mp2_energy);
-    printf("\nCalculation completed \nResults written to %s\n", output_file);
-
-    
     //--------------------------------------------------------------------------------//
     //                                 CLEANING UP                                    //
     //--------------------------------------------------------------------------------//
 
-    free(data);
-    free(index);
-    free(value);
-    free_4d(integral_array, mo_num, mo_num, mo_num);
+    for (int n = 0; n < n_inputs; n++) free(inputs[n]);
+    free(inputs);
+    free(results);
 
-    rc = trexio_close(file);
-    if (rc != TREXIO_SUCCESS) 
-    {
-        printf("TREXIO Error closing file: %s\n", trexio_string_of_error(rc));
-        return -1;
-    }
-
-    return 0;
+    return (n_failed == 0) ? 0 : 1;
 }
-
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "mp2_kernel.h"
+#if MP2_HAVE_X86
+#include <immintrin.h>
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Portable MP2 pair kernel
+// The denominator of row a is e_ij - e_a - e_b, with e_ij - e_a hoisted out of the b loop.
+// Row a of the tile <ji|ab> is column a of <ij|ab>, so the exchange integrals <ij|ba>
+// are read contiguously.
+void mp2_pair_scalar(const double* tile_ij, const double* tile_ji, const double* virt_energy, double e_ij, int n_virt, double* direct, double* exchange)
+{
+    double sum_direct = 0.0;
+    double sum_exchange = 0.0;
+
+    for (int a = 0; a < n_virt; a++)
+    {
+        const double* ijab = tile_ij + (size_t) a * n_virt;
+        const double* jiab = tile_ji + (size_t) a * n_virt;
+        double e_ija = e_ij - virt_energy[a];
+
+        for (int b = 0; b < n_virt; b++)
+        {
+            double inv_d = 1.0 / (e_ija - virt_energy[b]);
+            sum_direct   += ijab[b] * ijab[b] * inv_d;
+            sum_exchange += ijab[b] * jiab[b] * inv_d;
+        }
+    }
+
+    *direct = sum_direct;
+    *exchange = sum_exchange;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+#if MP2_HAVE_X86
+// AVX2/FMA MP2 pair kernel: 4 elements per vector
+// 1/D starts from the single-precision reciprocal estimate (12 bits) and is refined
+// by three Newton-Raphson steps (12 -> 24 -> 48 -> full precision) on the FMA units.
+__attribute__((target("avx2,fma")))
+static inline __m256d reciprocal_avx2(__m256d d)
+{
+    const __m256d two = _mm256_set1_pd(2.0);
+    __m256d r = _mm256_cvtps_pd(_mm_rcp_ps(_mm256_cvtpd_ps(d)));
+    r = _mm256_mul_pd(r, _mm256_fnmadd_pd(d, r, two));
+    r = _mm256_mul_pd(r, _mm256_fnmadd_pd(d, r, two));
+    r = _mm256_mul_pd(r, _mm256_fnmadd_pd(d, r, two));
+    return r;
+}
+
+__attribute__((target("avx2,fma")))
+static inline double horizontal_sum_avx2(__m256d x)
+{
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+__attribute__((target("avx2,fma")))
+void mp2_pair_avx2(const double* tile_ij, const double* tile_ji, const double* virt_energy, double e_ij, int n_virt, double* direct, double* exchange)
+{
+    __m256d sum_direct = _mm256_setzero_pd();
+    __m256d sum_exchange = _mm256_setzero_pd();
+    double tail_direct = 0.0;
+    double tail_exchange = 0.0;
+
+    for (int a = 0; a < n_virt; a++)
+    {
+        const double* ijab = tile_ij + (size_t) a * n_virt;
+        const double* jiab = tile_ji + (size_t) a * n_virt;
+        double e_ija = e_ij - virt_energy[a];
+        const __m256d d_a = _mm256_set1_pd(e_ija);
+
+        int b = 0;
+        for (; b + 4 <= n_virt; b += 4)
+        {
+            __m256d x = _mm256_loadu_pd(ijab + b);
+            __m256d y = _mm256_loadu_pd(jiab + b);
+            __m256d r = reciprocal_avx2(_mm256_sub_pd(d_a, _mm256_loadu_pd(virt_energy + b)));
+
+            // <ij|ab>^2 / D and <ij|ab> <ij|ba> / D
+            __m256d xr = _mm256_mul_pd(x, r);
+            sum_direct   = _mm256_fmadd_pd(xr, x, sum_direct);
+            sum_exchange = _mm256_fmadd_pd(xr, y, sum_exchange);
+        }
+        for (; b < n_virt; b++)
+        {
+            double inv_d = 1.0 / (e_ija - virt_energy[b]);
+            tail_direct   += ijab[b] * ijab[b] * inv_d;
+            tail_exchange += ijab[b] * jiab[b] * inv_d;
+        }
+    }
+
+    *direct = horizontal_sum_avx2(sum_direct) + tail_direct;
+    *exchange = horizontal_sum_avx2(sum_exchange) + tail_exchange;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// AVX-512 MP2 pair kernel: 8 elements per vector
+// 1/D starts from the 14-bit reciprocal estimate and is refined by two
+// Newton-Raphson steps (14 -> 28 -> 56 bits) on the FMA units.
+__attribute__((target("avx512f")))
+void mp2_pair_avx512(const double* tile_ij, const double* tile_ji, const double* virt_energy, double e_ij, int n_virt, double* direct, double* exchange)
+{
+    __m512d sum_direct = _mm512_setzero_pd();
+    __m512d sum_exchange = _mm512_setzero_pd();
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d one = _mm512_set1_pd(1.0);
+
+    for (int a = 0; a < n_virt; a++)
+    {
+        const double* ijab = tile_ij + (size_t) a * n_virt;
+        const double* jiab = tile_ji + (size_t) a * n_virt;
+        const __m512d d_a = _mm512_set1_pd(e_ij - virt_energy[a]);
+
+        for (int b = 0; b < n_virt; b += 8)
+        {
+            // The last vector of the row is masked instead of running a scalar tail
+            int left = n_virt - b;
+            __mmask8 mask = (left >= 8) ? (__mmask8) 0xFF : (__mmask8) ((1u << left) - 1u);
+
+            __m512d x = _mm512_maskz_loadu_pd(mask, ijab + b);
+            __m512d y = _mm512_maskz_loadu_pd(mask, jiab + b);
+
+            // Masked-off lanes get D = 1 so that their zero numerator stays zero
+            __m512d d = _mm512_mask_sub_pd(one, mask, d_a, _mm512_maskz_loadu_pd(mask, virt_energy + b));
+            __m512d r = _mm512_rcp14_pd(d);
+            r = _mm512_mul_pd(r, _mm512_fnmadd_pd(d, r, two));
+            r = _mm512_mul_pd(r, _mm512_fnmadd_pd(d, r, two));
+
+            __m512d xr = _mm512_mul_pd(x, r);
+            sum_direct   = _mm512_fmadd_pd(xr, x, sum_direct);
+            sum_exchange = _mm512_fmadd_pd(xr, y, sum_exchange);
+        }
+    }
+
+    *direct = _mm512_reduce_add_pd(sum_direct);
+    *exchange = _mm512_reduce_add_pd(sum_exchange);
+}
+
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Kernel chosen at the first call of mp2_kernel_select, for the whole run
+static pthread_once_t mp2_kernel_once = PTHREAD_ONCE_INIT;
+static mp2_pair_kernel_t mp2_kernel = mp2_pair_scalar;
+
+// Function to resolve the MP2 pair kernel from MP2_SIMD and the CPU
+static mp2_pair_kernel_t mp2_kernel_resolve(void)
+{
+    const char* forced = getenv("MP2_SIMD");
+#if MP2_HAVE_X86
+    __builtin_cpu_init();
+    int has_avx512 = __builtin_cpu_supports("avx512f");
+    int has_avx2   = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+
+    if (forced != NULL)
+    {
+        if (strcmp(forced, "scalar") == 0) return mp2_pair_scalar;
+#if MP2_HAVE_X86
+        if (strcmp(forced, "avx2") == 0 && has_avx2) return mp2_pair_avx2;
+        if (strcmp(forced, "avx512") == 0 && has_avx512) return mp2_pair_avx512;
+#endif
+        printf("Warning: MP2_SIMD=%s is not available on this CPU, selecting automatically.\n", forced);
+    }
+
+#if MP2_HAVE_X86
+    if (has_avx512) return mp2_pair_avx512;
+    if (has_avx2) return mp2_pair_avx2;
+#endif
+    return mp2_pair_scalar;
+}
+
+static void mp2_kernel_init(void)
+{
+    mp2_kernel = mp2_kernel_resolve();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to select the MP2 pair kernel at run time
+// The environment and the CPU are read once (so a warning is printed once), even when the
+// workers of a batch call it at the same time.
+mp2_pair_kernel_t mp2_kernel_select(void)
+{
+    pthread_once(&mp2_kernel_once, mp2_kernel_init);
+    return mp2_kernel;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function returning the name of an MP2 pair kernel
+const char* mp2_kernel_name(mp2_pair_kernel_t kernel)
+{
+#if MP2_HAVE_X86
+    if (kernel == mp2_pair_avx512) return "avx512";
+    if (kernel == mp2_pair_avx2) return "avx2";
+#endif
+    return "scalar";
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
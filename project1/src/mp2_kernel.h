@@ -0,0 +1,42 @@
+#ifndef MP2_KERNEL_H
+#define MP2_KERNEL_H
+
+// The SIMD kernels are only built for x86; elsewhere the scalar kernel is the only one
+#if defined(__x86_64__) || defined(__i386__)
+#define MP2_HAVE_X86 1
+#else
+#define MP2_HAVE_X86 0
+#endif
+
+// Kernel computing the direct and exchange sums of the occupied pair (i,j):
+//     direct = sum_ab <ij|ab>^2 / D,   exchange = sum_ab <ij|ab> <ij|ba> / D
+// with D = e_i + e_j - e_a - e_b. The pair (j,i) has the same two sums, so the pair
+// energy 2 direct - exchange of both (i,j) and (j,i) comes from one sweep. The direct
+// sum is the opposite-spin energy of the pair, direct - exchange the same-spin one.
+// Parameters:
+// - tile_ij: n_virt x n_virt tile <ij|ab>, row a contiguous
+// - tile_ji: n_virt x n_virt tile <ji|ab> = <ij|ba>
+// - virt_energy: Energies of the virtual orbitals
+// - e_ij: Sum of the occupied orbital energies e_i + e_j
+// - n_virt: Number of virtual orbitals
+// - direct, exchange: Direct and exchange sums of the pair
+typedef void (*mp2_pair_kernel_t)(const double* tile_ij, const double* tile_ji, const double* virt_energy, double e_ij, int n_virt, double* direct, double* exchange);
+
+// Portable kernel, always available
+void mp2_pair_scalar(const double* tile_ij, const double* tile_ji, const double* virt_energy, double e_ij, int n_virt, double* direct, double* exchange);
+
+#if MP2_HAVE_X86
+// AVX2/FMA and AVX-512 kernels, only to be called when the CPU supports them
+void mp2_pair_avx2(const double* tile_ij, const double* tile_ji, const double* virt_energy, double e_ij, int n_virt, double* direct, double* exchange);
+void mp2_pair_avx512(const double* tile_ij, const double* tile_ji, const double* virt_energy, double e_ij, int n_virt, double* direct, double* exchange);
+#endif
+
+// Function to select the fastest kernel supported by the CPU.
+// The choice can be forced with MP2_SIMD=scalar|avx2|avx512; it is made at the first call
+// and kept for the rest of the run.
+mp2_pair_kernel_t mp2_kernel_select(void);
+
+// Function returning the name of a kernel ("scalar", "avx2" or "avx512")
+const char* mp2_kernel_name(mp2_pair_kernel_t kernel);
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "mp2_kernel.h"
+
+//--------------------------------------------------------------------------------//
+//                    MICRO-BENCHMARK OF THE MP2 PAIR KERNELS                     //
+//--------------------------------------------------------------------------------//
+
+// Usage: mp2_kernel_bench [n_occ] [n_virt] [repetitions]
+// Runs every kernel supported by the CPU over a synthetic (ov|ov) block on one core
+// and compares them with the original one-pair-at-a-time loop.
+
+static double wall_time(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1.0e-9 * t.tv_nsec;
+}
+
+// The MP2 loop as it was before the pair kernels: every ordered pair (i,j) in a single pass
+// over its tile and the exchange tile of (j,i), one division per element
+static double run_reference(const double* oovv, const double* mo_energy, int n_occ, int n_virt)
+{
+    size_t tile = (size_t) n_virt * n_virt;
+    const double* virt_energy = mo_energy + n_occ;
+    double energy = 0.0;
+
+    for (int i = 0; i < n_occ; i++)
+    {
+        for (int j = 0; j < n_occ; j++)
+        {
+            const double* coulomb = oovv + (i * n_occ + j) * tile;
+            const double* exchange = oovv + (j * n_occ + i) * tile;
+            double e_ij = mo_energy[i] + mo_energy[j];
+            double energy_ij = 0.0;
+
+            for (int a = 0; a < n_virt; a++)
+            {
+                for (int b = 0; b < n_virt; b++)
+                {
+                    double ijab = coulomb[a * n_virt + b];
+                    double ijba = exchange[a * n_virt + b];
+                    energy_ij += ijab * (2.0 * ijab - ijba) / (e_ij - virt_energy[a] - virt_energy[b]);
+                }
+            }
+            energy += energy_ij;
+        }
+    }
+    return energy;
+}
+
+static double run_kernel(mp2_pair_kernel_t kernel, const double* oovv, const double* mo_energy, int n_occ, int n_virt)
+{
+    size_t tile = (size_t) n_virt * n_virt;
+    double energy = 0.0;
+
+    for (int i = 0; i < n_occ; i++)
+    {
+        for (int j = i; j < n_occ; j++)
+        {
+            double direct, exchange;
+            kernel(oovv + (i * n_occ + j) * tile, oovv + (j * n_occ + i) * tile,
+                   mo_energy + n_occ, mo_energy[i] + mo_energy[j], n_virt, &direct, &exchange);
+            energy += ((i == j) ? 1.0 : 2.0) * (2.0 * direct - exchange);
+        }
+    }
+    return energy;
+}
+
+int main(int argc, char** argv)
+{
+    int n_occ  = (argc > 1) ? atoi(argv[1]) : 10;
+    int n_virt = (argc > 2) ? atoi(argv[2]) : 150;
+    int n_rep  = (argc > 3) ? atoi(argv[3]) : 20;
+
+    size_t n_elem = (size_t) n_occ * n_occ * n_virt * n_virt;
+
+    // The reference sweeps the tiles of every ordered pair, the kernels those of the pairs i <= j only
+    size_t n_visited = (size_t) n_occ * (n_occ + 1) / 2 * n_virt * n_virt;
+    double* oovv = malloc(n_elem * sizeof(double));
+    double* mo_energy = malloc((n_occ + n_virt) * sizeof(double));
+    if (oovv == NULL || mo_energy == NULL)
+    {
+        printf("Memory allocation failed for the benchmark block!\n");
+        return -1;
+    }
+
+    // Occupied energies below zero, virtual ones above: all denominators are negative
+    srand(12345);
+    for (int p = 0; p < n_occ; p++) mo_energy[p] = -2.0 + 1.5 * p / n_occ;
+    for (int p = 0; p < n_virt; p++) mo_energy[n_occ + p] = 0.1 + 3.0 * p / n_virt;
+
+    // Random tiles with the symmetry of the integrals: <ji|ba> = <ij|ab>
+    for (int i = 0; i < n_occ; i++)
+    {
+        for (int j = i; j < n_occ; j++)
+        {
+            for (int a = 0; a < n_virt; a++)
+            {
+                for (int b = 0; b < n_virt; b++)
+                {
+                    double x = 0.2 * ((double) rand() / RAND_MAX - 0.5);
+                    oovv[(((size_t) i * n_occ + j) * n_virt + a) * n_virt + b] = x;
+                    oovv[(((size_t) j * n_occ + i) * n_virt + b) * n_virt + a] = x;
+                }
+            }
+        }
+    }
+
+    mp2_pair_kernel_t kernels[4] = { NULL, mp2_pair_scalar, NULL, NULL };
+    const char* names[4] = { "reference", "scalar", "avx2", "avx512" };
+#if MP2_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) kernels[2] = mp2_pair_avx2;
+    if (__builtin_cpu_supports("avx512f")) kernels[3] = mp2_pair_avx512;
+#endif
+
+    printf("n_occ = %d, n_virt = %d, %zu elements (%.1f MB), %zu visited per pass by the kernels, %d repetitions\n\n",
+           n_occ, n_virt, n_elem, n_elem * sizeof(double) / 1.0e6, n_visited, n_rep);
+    printf("%-10s %12s %14s %10s %10s %22s\n", "kernel", "time (ms)", "elements/s", "GFlop/s", "speedup", "E(MP2)");
+
+    double t_reference = 0.0;
+    double e_reference = 0.0;
+    for (int n_k = 0; n_k < 4; n_k++)
+    {
+        if (n_k > 0 && kernels[n_k] == NULL) continue;
+
+        // One warm-up pass, then keep the best repetition
+        double energy = 0.0;
+        double best = 1.0e30;
+        for (int rep = -1; rep < n_rep; rep++)
+        {
+            double start = wall_time();
+            energy = (n_k == 0) ? run_reference(oovv, mo_energy, n_occ, n_virt)
+                                : run_kernel(kernels[n_k], oovv, mo_energy, n_occ, n_virt);
+            double elapsed = wall_time() - start;
+            if (rep >= 0 && elapsed < best) best = elapsed;
+        }
+
+        if (n_k == 0)
+        {
+            t_reference = best;
+            e_reference = energy;
+        }
+
+        // 7 floating-point operations per element visited (2 sub, div, 2 mul, 2 add for the kernels;
+        // 3 sub, div, 2 mul, add for the reference)
+        size_t n_swept = (n_k == 0) ? n_elem : n_visited;
+        printf("%-10s %12.3f %14.3e %10.2f %9.2fx %22.15f (%+.1e)\n", names[n_k],
+               1.0e3 * best, n_swept / best, 7.0 * n_swept / best / 1.0e9, t_reference / best, energy, energy - e_reference);
+    }
+
+    free(oovv);
+    free(mo_energy);
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "mp2.h"
+
+//--------------------------------------------------------------------------------//
+//                  DISTRIBUTED MP2 OVER MPI PROCESSES (make mpi)                 //
+//--------------------------------------------------------------------------------//
+
+// Usage: mpirun -np N ./mp2_mpi [options] file.h5 ...
+// The active occupied rows of the (ov|ov) block are dealt to the processes in turn (row i to
+// process i mod N), so that each one keeps about 1/N of the block, the largest array of the
+// calculation, and sums the pairs (i,j), i <= j, of its rows. The TREXIO file is streamed by
+// every process, each one keeping its own rows: the integrals of a row are spread over the
+// whole file, so there is no part of the file to skip. The (oo|oo) block is small and kept
+// everywhere. The pair sums are added over the processes with every entry coming from a single
+// process, which is exact, so the energies are those of mp2_energy whatever N.
+
+// Function to print the usage
+static void usage(const char* program)
+{
+    printf("Usage: mpirun -np N %s [options] file.h5 ...\n", program);
+    printf("  -t threads    OpenMP threads per process (default: OMP_NUM_THREADS)\n");
+    printf("  -P precision  storage of the (ov|ov) block: double (default), float or mixed\n");
+    printf("  -F count      number of lowest occupied orbitals kept frozen in MP2 (default 0)\n");
+    printf("  -p            also write the MP2 pair energies (file.pairs.txt)\n");
+    printf("  -m MB         memory for the integral read buffers of each process\n");
+    printf("  -q depth      chunk buffers read ahead of the unpacking (default %d)\n", ERI_DEPTH_DEFAULT);
+    printf("The reports are written by process 0, as with mp2_energy -l blocks.\n");
+}
+
+// Function returning the peak resident memory of the process in kB
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+    return (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : 0;
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+
+    int rank, n_ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+
+    //--------------------------------------------------------------------------------//
+    //                               COMMAND LINE OPTIONS                             //
+    //--------------------------------------------------------------------------------//
+
+    mp2_options_t options;
+    mp2_options_default(&options);
+    options.rank = rank;
+    options.n_ranks = n_ranks;
+    int n_threads = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:P:F:pm:q:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                n_threads = atoi(optarg);
+                break;
+            case 'P':
+                options.precision = (strcmp(optarg, "double") == 0) ? BLOCKS_DOUBLE :
+                                    (strcmp(optarg, "float") == 0)  ? BLOCKS_FLOAT :
+                                    (strcmp(optarg, "mixed") == 0)  ? BLOCKS_MIXED : -1;
+                break;
+            case 'F':
+                options.n_frozen = atoi(optarg);
+                break;
+            case 'p':
+                options.write_pairs = 1;
+                break;
+            case 'm':
+                options.memory_budget = (int64_t) (atof(optarg) * 1024 * 1024);
+                break;
+            case 'q':
+                options.read_depth = atoi(optarg);
+                break;
+            default:
+                if (rank == 0) usage(argv[0]);
+                MPI_Finalize();
+                return (opt == 'h') ? 0 : -1;
+        }
+    }
+
+    if (options.precision < 0 || options.n_frozen < 0 || options.read_depth < 1 || options.read_depth > ERI_DEPTH_MAX ||
+        optind >= argc)
+    {
+        if (rank == 0) usage(argv[0]);
+        MPI_Finalize();
+        return -1;
+    }
+
+#ifdef _OPENMP
+    if (n_threads > 0) omp_set_num_threads(n_threads);
+#else
+    if (n_threads > 1 && rank == 0) printf("Warning: built without OpenMP, running on a single thread (use make omp).\n");
+#endif
+
+    mp2_context_t* context = mp2_context_create(&options);
+    if (context == NULL)
+    {
+        printf("Memory allocation failed for the context of process %d!\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    //--------------------------------------------------------------------------------//
+    //                          PROCESSING THE MOLECULES                              //
+    //--------------------------------------------------------------------------------//
+
+    if (rank == 0) printf("Processing %d file%s with %d process%s . . .\n", argc - optind, (argc - optind > 1) ? "s" : "",
+                          n_ranks, (n_ranks > 1) ? "es" : "");
+    int n_failed = 0;
+
+    for (int n = optind; n < argc; n++)
+    {
+        const char* input_filename = argv[n];
+        double start_time = profile_clock();
+
+        // Every process needs its slice before the pair sums are added
+        int failed = (mp2_load(context, input_filename) != 0);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (failed)
+        {
+            const mp2_result_t* result = mp2_context_result(context);
+            if (rank == 0) printf("%s: %s\n", input_filename, (result->status != 0) ? result->message : "Error: Loading failed on another process.");
+            n_failed++;
+            continue;
+        }
+
+        const mp2_result_t* result = mp2_context_result(context);
+        int n_active = result->n_up - result->n_frozen;
+        size_t n_ordered = (size_t) n_active * n_active;
+
+        double* direct = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+        double* exchange = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+        double* direct_total = NULL;
+        double* exchange_total = NULL;
+        if (rank == 0)
+        {
+            direct_total = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+            exchange_total = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+            if (direct_total == NULL || exchange_total == NULL) MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        if (direct == NULL || exchange == NULL) MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+
+        // The sums of every process are needed, a failure on any of them fails the molecule
+        failed = (mp2_compute_pair_sums(context, direct, exchange) != 0);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (failed)
+        {
+            if (rank == 0) printf("%s: %s\n", input_filename, (result->status != 0) ? result->message : "Error: The pair sums failed on another process.");
+            n_failed++;
+            free(direct);
+            free(exchange);
+            free(direct_total);
+            free(exchange_total);
+            continue;
+        }
+        MPI_Reduce(direct, direct_total, (int) n_ordered, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(exchange, exchange_total, (int) n_ordered, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+        // Memory of the largest process and of all of them
+        long peak = peak_rss_kb();
+        long peak_max = 0, peak_total = 0;
+        MPI_Reduce(&peak, &peak_max, 1, MPI_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&peak, &peak_total, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+        if (rank == 0)
+        {
+            mp2_pairs_t pairs;
+            memset(&pairs, 0, sizeof(pairs));
+            if (options.write_pairs)
+            {
+                pairs.pair_energy = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+                if (pairs.pair_energy == NULL) MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+
+            double hf_energy, mp2_energy;
+            if (mp2_compute_hf(context, &hf_energy) != 0 ||
+                mp2_compute_mp2_from_sums(context, direct_total, exchange_total, &pairs, &mp2_energy) != 0)
+            {
+                printf("%s: %s\n", input_filename, result->message);
+                n_failed++;
+            }
+            else
+            {
+                mp2_write_reports(context, &pairs, start_time);
+                printf("%s: HF = %.6f, MP2 = %.6f (%.3f s, peak memory %.1f MB per process, %.1f MB in all) -> %s\n",
+                       input_filename, hf_energy, mp2_energy, profile_clock() - start_time, peak_max / 1024.0,
+                       peak_total / 1024.0, result->output_filename);
+            }
+            free(pairs.pair_energy);
+        }
+
+        free(direct);
+        free(exchange);
+        free(direct_total);
+        free(exchange_total);
+    }
+
+    if (rank == 0) printf("\nCalculation completed: %d succeeded, %d failed\n", argc - optind - n_failed, n_failed);
+
+    mp2_context_free(context);
+    MPI_Finalize();
+    return (n_failed > 0) ? -1 : 0;
+}
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <trexio.h>
+
+//--------------------------------------------------------------------------------//
+//                  GENERATOR OF SYNTHETIC TREXIO INPUT FILES                     //
+//--------------------------------------------------------------------------------//
+
+// Usage: mp2_synth output.h5 mo_num n_up [seed] [rank]
+// Writes a closed-shell "molecule" of any size for benchmarks and scaling curves.
+// The integrals are built as (pq|rs) = sum_P B_P(pq) B_P(rs) from rank symmetric
+// matrices B_P that decay away from the diagonal, so that they have the 8-fold symmetry
+// and the positive (ia|jb) matrix of real integrals. Only the unique integrals are written,
+// in the physicist order <pr|qs> = (pq|rs) of the trexio files. The same arguments always
+// give the same file.
+
+#define SYNTH_CHUNK 65536
+
+// Function returning the next number of a xorshift generator, uniform in [-0.5, 0.5)
+static double synth_random(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (double) (*state >> 11) / 9007199254740992.0 - 0.5;
+}
+
+// Function to report a trexio error and exit
+static void synth_check(trexio_exit_code rc, const char* what)
+{
+    if (rc != TREXIO_SUCCESS)
+    {
+        printf("TREXIO Error %s: %s\n", what, trexio_string_of_error(rc));
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        printf("Usage: %s output.h5 mo_num n_up [seed] [rank]\n", argv[0]);
+        return -1;
+    }
+
+    const char* filename = argv[1];
+    int mo_num = atoi(argv[2]);
+    int n_up   = atoi(argv[3]);
+    uint64_t seed = (argc > 4) ? strtoull(argv[4], NULL, 10) : 1;
+    int rank   = (argc > 5) ? atoi(argv[5]) : 8;
+
+    if (mo_num < 2 || n_up < 1 || n_up >= mo_num || rank < 1)
+    {
+        printf("Error: Need 0 < n_up < mo_num and rank > 0.\n");
+        return -1;
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL ^ (seed * 0xBF58476D1CE4E5B9ULL);
+    if (state == 0) state = 1;
+
+    //--------------------------------------------------------------------------------//
+    //                       ORBITAL ENERGIES AND CORE HAMILTONIAN                    //
+    //--------------------------------------------------------------------------------//
+
+    double* mo_energy = malloc(mo_num * sizeof(double));
+    double* core = malloc((size_t) mo_num * mo_num * sizeof(double));
+    double* factor = malloc((size_t) rank * mo_num * mo_num * sizeof(double));
+    if (mo_energy == NULL || core == NULL || factor == NULL)
+    {
+        printf("Memory allocation failed for the synthetic system!\n");
+        return -1;
+    }
+
+    // Occupied energies below zero, virtual ones above, in increasing order
+    for (int p = 0; p < n_up; p++) mo_energy[p] = -2.0 + 1.6 * p / n_up;
+    for (int p = n_up; p < mo_num; p++) mo_energy[p] = 0.1 + 3.0 * (p - n_up) / (mo_num - n_up);
+
+    for (int p = 0; p < mo_num; p++)
+    {
+        core[p * mo_num + p] = 2.5 * mo_energy[p] - 1.0;
+        for (int q = 0; q < p; q++)
+        {
+            double x = 0.2 * synth_random(&state) * exp(-(p - q) / 4.0);
+            core[p * mo_num + q] = x;
+            core[q * mo_num + p] = x;
+        }
+    }
+
+    // The first factor carries the large Coulomb-like diagonal
+    for (int n = 0; n < rank; n++)
+    {
+        double* b = factor + (size_t) n * mo_num * mo_num;
+        for (int p = 0; p < mo_num; p++)
+        {
+            for (int q = 0; q <= p; q++)
+            {
+                double x = 0.3 * synth_random(&state) * exp(-(p - q) / 4.0);
+                if (n == 0 && p == q) x += 0.6;
+                b[p * mo_num + q] = x;
+                b[q * mo_num + p] = x;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------//
+    //                                WRITING THE FILE                                //
+    //--------------------------------------------------------------------------------//
+
+    unlink(filename);
+    trexio_exit_code rc;
+    trexio_t* file = trexio_open(filename, 'w', TREXIO_HDF5, &rc);
+    synth_check(rc, "opening file");
+
+    synth_check(trexio_write_nucleus_repulsion(file, 0.5 * mo_num), "writing nuclear repulsion energy");
+    synth_check(trexio_write_electron_up_num(file, n_up), "writing number of up-spin electrons");
+    synth_check(trexio_write_electron_dn_num(file, n_up), "writing number of down-spin electrons");
+    synth_check(trexio_write_mo_num(file, mo_num), "writing number of molecular orbitals");
+    synth_check(trexio_write_mo_energy(file, mo_energy), "writing molecular orbital energies");
+    synth_check(trexio_write_mo_1e_int_core_hamiltonian(file, core), "writing one-electron integrals");
+
+    int32_t* index = malloc(4 * SYNTH_CHUNK * sizeof(int32_t));
+    double* value = malloc(SYNTH_CHUNK * sizeof(double));
+    if (index == NULL || value == NULL)
+    {
+        printf("Memory allocation failed for the integral buffers!\n");
+        return -1;
+    }
+
+    // Unique integrals: p >= q, r >= s and pair (pq) >= pair (rs)
+    int64_t offset = 0;
+    int64_t count = 0;
+    for (int p = 0; p < mo_num; p++)
+    {
+        for (int q = 0; q <= p; q++)
+        {
+            for (int r = 0; r <= p; r++)
+            {
+                int s_max = (r == p) ? q : r;
+                for (int s = 0; s <= s_max; s++)
+                {
+                    double x = 0.0;
+                    for (int n = 0; n < rank; n++)
+                    {
+                        const double* b = factor + (size_t) n * mo_num * mo_num;
+                        x += b[p * mo_num + q] * b[r * mo_num + s];
+                    }
+
+                    index[4 * count + 0] = p;
+                    index[4 * count + 1] = r;
+                    index[4 * count + 2] = q;
+                    index[4 * count + 3] = s;
+                    value[count] = x;
+                    if (++count == SYNTH_CHUNK)
+                    {
+                        synth_check(trexio_write_mo_2e_int_eri(file, offset, count, index, value), "writing two-electron integrals");
+                        offset += count;
+                        count = 0;
+                    }
+                }
+            }
+        }
+    }
+    if (count > 0)
+    {
+        synth_check(trexio_write_mo_2e_int_eri(file, offset, count, index, value), "writing two-electron integrals");
+        offset += count;
+    }
+
+    synth_check(trexio_close(file), "closing file");
+    printf("%s: mo_num %d, n_up %d, %lld integrals\n", filename, mo_num, n_up, (long long) offset);
+
+    free(index);
+    free(value);
+    free(factor);
+    free(core);
+    free(mo_energy);
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "profile.h"
+
+// Version of the program recorded in the JSON files, set by the Makefile from git
+#ifndef MP2_VERSION
+#define MP2_VERSION "unknown"
+#endif
+
+static const char* phase_names[PROFILE_N_PHASES] =
+{
+    "setup", "eri_read", "eri_scatter", "cholesky", "cache", "hf", "mp2"
+};
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function returning a monotonic time in seconds
+double profile_clock(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1.0e-9 * t.tv_nsec;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function returning the name of a phase
+const char* profile_phase_name(int phase)
+{
+    return (phase >= 0 && phase < PROFILE_N_PHASES) ? phase_names[phase] : "unknown";
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to record the peak memory and the threads at the end of a calculation
+// The peak RSS is that of the whole process: with several workers it covers all of them.
+void profile_finish(mp2_profile_t* profile)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) profile->peak_rss_kb = usage.ru_maxrss;
+
+#ifdef _OPENMP
+    profile->n_threads = omp_get_max_threads();
+#else
+    profile->n_threads = 1;
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to compute the rates of a calculation
+static void profile_rates(const mp2_profile_t* profile, double* integral_rate, double* mp2_rate)
+{
+    double eri_time = profile->time[PROFILE_ERI_READ] + profile->time[PROFILE_ERI_SCATTER];
+    *integral_rate = (eri_time > 0.0) ? profile->integrals_read / eri_time : 0.0;
+    *mp2_rate = (profile->time[PROFILE_MP2] > 0.0) ? profile->mp2_flops / profile->time[PROFILE_MP2] : 0.0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to print the timings and rates of a calculation in a report
+void profile_print(FILE* file, const mp2_profile_t* profile)
+{
+    double integral_rate, mp2_rate;
+    profile_rates(profile, &integral_rate, &mp2_rate);
+
+    fprintf(file, "Performance:\n\n");
+    for (int phase = 0; phase < PROFILE_N_PHASES; phase++)
+    {
+        fprintf(file, "  %-28s : %12.6f s\n", profile_phase_name(phase), profile->time[phase]);
+    }
+    fprintf(file, "  %-28s : %12.6f s\n", "total", profile->total_time);
+    fprintf(file, "  %-28s : %12.3f MB\n", "Bytes Read", profile->bytes_read / 1.0e6);
+    fprintf(file, "  %-28s : %12.6f s (queue depth %d)\n", "Reads Overlapped", profile->read_overlap, profile->read_depth);
+    fprintf(file, "  %-28s : %12.3e /s\n", "Integrals Processed", integral_rate);
+    fprintf(file, "  %-28s : %12.3f GFlop/s\n", "MP2 Flop Rate", mp2_rate / 1.0e9);
+    fprintf(file, "  %-28s : %12.1f MB\n", "Peak Resident Memory", profile->peak_rss_kb / 1024.0);
+    fprintf(file, "  %-28s : %12d (%s kernel)\n", "Threads", profile->n_threads, profile->kernel);
+    fprintf(file, "  %-28s : %12s\n", "Integral Storage", profile->precision);
+    if (profile->laplace_points > 0)
+        fprintf(file, "  %-28s : %12d points (denominators within %.1e, MP2 within %.1e Eh)\n", "Laplace Quadrature",
+                profile->laplace_points, profile->laplace_error, profile->laplace_bound);
+    if (profile->screening > 0.0)
+        fprintf(file, "  %-28s : %12.1e (%lld of %lld tiles kept, %lld pairs skipped within %.1e Eh)\n", "Integral Screening",
+                profile->screening, (long long) profile->tiles_kept, (long long) profile->tiles_total,
+                (long long) profile->pairs_skipped, profile->screening_bound);
+    fprintf(file, "---------------------------------------------\n");
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write a string as a JSON string literal
+void write_json_string(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write the timings and rates of a calculation as a JSON sidecar file
+// The keys stay stable from one version to the next so that the files can be compared.
+// Parameters:
+// - filename: Output file
+// - input_filename: TREXIO file of the calculation
+// - load_mode: Integral storage ("blocks", "full" or "cholesky")
+// - n_up, mo_num, n_frozen: Dimensions of the calculation
+// - profile: Timings and counters
+int profile_write_json(const char* filename, const char* input_filename, const char* load_mode, int n_up, int mo_num,
+                       int n_frozen, const mp2_profile_t* profile)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        printf("Error: Unable to create profile file %s\n", filename);
+        return -1;
+    }
+
+    double integral_rate, mp2_rate;
+    profile_rates(profile, &integral_rate, &mp2_rate);
+
+    fprintf(file, "{\n  \"version\": ");
+    write_json_string(file, MP2_VERSION);
+    fprintf(file, ",\n  \"input\": ");
+    write_json_string(file, input_filename);
+    fprintf(file, ",\n  \"load_mode\": \"%s\", \"precision\": \"%s\", \"kernel\": \"%s\", \"threads\": %d,\n", load_mode,
+            profile->precision, profile->kernel, profile->n_threads);
+    fprintf(file, "  \"n_up\": %d, \"mo_num\": %d, \"n_frozen\": %d,\n", n_up, mo_num, n_frozen);
+    fprintf(file, "  \"phases\": {");
+    for (int phase = 0; phase < PROFILE_N_PHASES; phase++)
+    {
+        fprintf(file, "%s\"%s\": %.6f", (phase > 0) ? ", " : "", profile_phase_name(phase), profile->time[phase]);
+    }
+    fprintf(file, "},\n");
+    fprintf(file, "  \"total_time\": %.6f,\n", profile->total_time);
+    fprintf(file, "  \"bytes_read\": %lld, \"integrals_read\": %lld, \"integrals_per_second\": %.6e,\n",
+            (long long) profile->bytes_read, (long long) profile->integrals_read, integral_rate);
+    fprintf(file, "  \"read_depth\": %d, \"read_overlap\": %.6f,\n", profile->read_depth, profile->read_overlap);
+    fprintf(file, "  \"mp2_flops\": %.6e, \"mp2_flops_per_second\": %.6e,\n", profile->mp2_flops, mp2_rate);
+    fprintf(file, "  \"laplace_points\": %d, \"laplace_error\": %.3e, \"laplace_bound\": %.3e,\n", profile->laplace_points,
+            profile->laplace_error, profile->laplace_bound);
+    fprintf(file, "  \"screening\": %.3e, \"tiles_kept\": %lld, \"tiles_total\": %lld, \"pairs_skipped\": %lld, \"screening_bound\": %.3e,\n",
+            profile->screening, (long long) profile->tiles_kept, (long long) profile->tiles_total,
+            (long long) profile->pairs_skipped, profile->screening_bound);
+    fprintf(file, "  \"peak_rss_kb\": %ld\n}\n", profile->peak_rss_kb);
+
+    fclose(file);
+    return 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,60 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Phases timed for each molecule
+#define PROFILE_SETUP       0   // Opening the file, scalars and one-electron data
+#define PROFILE_ERI_READ    1   // Waiting for the two-electron integrals of the file (reads not overlapped)
+#define PROFILE_ERI_SCATTER 2   // Folding the integrals into blocks, store or Cholesky columns
+#define PROFILE_CHOLESKY    3   // Building the Cholesky vectors (without the passes over the file)
+#define PROFILE_CACHE       4   // Hashing the input, mapping or writing the integral cache
+#define PROFILE_HF          5   // HF energy
+#define PROFILE_MP2         6   // MP2 energy
+#define PROFILE_N_PHASES    7
+
+// Timings and counters of the calculation of one molecule
+typedef struct
+{
+    double time[PROFILE_N_PHASES];  // Seconds spent in each phase
+    double total_time;              // Seconds from the start to the writing of the report
+    int64_t bytes_read;             // Bytes read from the TREXIO file (records of every pass)
+    int64_t integrals_read;         // Two-electron integrals read (over every pass)
+    double read_overlap;            // Seconds of reads hidden behind the folds by the read queue
+    int read_depth;                 // Chunk buffers of the read queue
+    double mp2_flops;               // Floating-point operations of the MP2 step (operation count model)
+    long peak_rss_kb;               // Peak resident set size of the process so far, in kB
+    int n_threads;                  // OpenMP threads available to the MP2 step
+    const char* kernel;             // MP2 pair kernel
+    const char* precision;          // Storage precision of the integrals
+    int laplace_points;             // Laplace quadrature points of the MP2 denominators (0: exact)
+    double laplace_error;           // Largest relative error of the quadrature over the denominators
+    double laplace_bound;           // Resulting bound on the error of the MP2 energy (hartree)
+    double screening;               // Magnitude below which the (ov|ov) integrals were dropped (0: none)
+    int64_t tiles_kept;             // Tiles of the screened (ov|ov) block holding integrals
+    int64_t tiles_total;            // Tiles of the (ov|ov) block
+    int64_t pairs_skipped;          // Unordered pairs left out of MP2 by their energy bound
+    double screening_bound;         // Sum of the energy bounds of the pairs skipped (hartree)
+} mp2_profile_t;
+
+// Function returning a monotonic time in seconds
+double profile_clock(void);
+
+// Function returning the name of a phase
+const char* profile_phase_name(int phase);
+
+// Function to record the peak memory and the threads at the end of a calculation
+void profile_finish(mp2_profile_t* profile);
+
+// Function to print the timings and rates of a calculation in a report
+void profile_print(FILE* file, const mp2_profile_t* profile);
+
+// Function to write a string as a JSON string literal
+void write_json_string(FILE* file, const char* text);
+
+// Function to write the timings and rates of a calculation as a JSON sidecar file. Returns 0 on success.
+int profile_write_json(const char* filename, const char* input_filename, const char* load_mode, int n_up, int mo_num,
+                       int n_frozen, const mp2_profile_t* profile);
+
+#endif
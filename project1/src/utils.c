@@ -1,58 +1,75 @@
 #include <stdio.h>
 #include <trexio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "eri.h"
+#include "blocks.h"
+#include "cholesky.h"
+#include "mp2_kernel.h"
+#include "utils.h"
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------
 
-// Function to allocate a 4D array to acces the nth integral
-double ****malloc_4d(int size_i, int size_j, int size_k, int size_l) 
-{    
-    // For the first dimension
-    double ****array = (double ****)malloc(size_i * sizeof(double ***));
-    if (array == NULL) exit(EXIT_FAILURE);
-
-    // For the second dimension
-    for (int i = 0; i < size_i; i++) 
-    {
-        array[i] = (double ***)malloc(size_j * sizeof(double **));
-        if (array[i] == NULL) exit(EXIT_FAILURE);
-
-        // For the third dimension
-        for (int j = 0; j < size_j; j++) 
-	{
-            array[i][j] = (double **)malloc(size_k * sizeof(double *));
-            if (array[i][j] == NULL) exit(EXIT_FAILURE);
-
-            // For the fourth dimension
-            for (int k = 0; k < size_k; k++) 
-	    {
-                array[i][j][k] = (double *)malloc(size_l * sizeof(double));
-                if (array[i][j][k] == NULL) exit(EXIT_FAILURE);
-            }
-        }
+// Function to sum partial results in a fixed order
+// The threaded kernels store one partial sum per row or (i,j) pair and combine
+// them here, so the printed energies do not depend on the number of threads.
+static double sum_in_order(const double *partial, int n)
+{
+    double sum = 0.0;
+    for (int n_term = 0; n_term < n; n_term++)
+    {
+        sum += partial[n_term];
     }
-
-    return array;
+    return sum;
 }
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------
 
-// Function to free the 4D array
-void free_4d(double ****array, int size_i, int size_j, int size_k) 
+// Function to combine the direct and exchange sums of the pairs into the MP2 energy
+// The pair energy of (i,j) is 2 direct - exchange; its opposite-spin part is the direct
+// sum and its same-spin part direct - exchange. All the sums run in a fixed order.
+// Parameters:
+// - direct, exchange: Sums of the n_active x n_active ordered pairs
+// - n_active: Number of correlated occupied orbitals
+// - pairs: Receives the pair energies and spin components (may be NULL)
+// Returns NAN if memory runs out, as do the energy functions below.
+double combine_pairs(const double *direct, const double *exchange, int n_active, mp2_pairs_t *pairs)
 {
-    for (int i = 0; i < size_i; i++) 
+    int n_pair = n_active * n_active;
+    double *pair_energy = malloc((n_pair > 0 ? n_pair : 1) * sizeof(double));
+    double *same_spin = malloc((n_pair > 0 ? n_pair : 1) * sizeof(double));
+    if (pair_energy == NULL || same_spin == NULL)
     {
-        for (int j = 0; j < size_j; j++) 
-	{
-            for (int k = 0; k < size_k; k++) 
-	    {
-                free(array[i][j][k]); 
-            }
-            free(array[i][j]); 
+        free(pair_energy);
+        free(same_spin);
+        return NAN;
+    }
+
+    for (int p = 0; p < n_pair; p++)
+    {
+        pair_energy[p] = 2.0 * direct[p] - exchange[p];
+        same_spin[p] = direct[p] - exchange[p];
+    }
+
+    double energy_mp2 = sum_in_order(pair_energy, n_pair);
+    if (pairs != NULL)
+    {
+        pairs->n_active = n_active;
+        pairs->opposite_spin = sum_in_order(direct, n_pair);
+        pairs->same_spin = sum_in_order(same_spin, n_pair);
+        if (pairs->pair_energy != NULL)
+        {
+            for (int p = 0; p < n_pair; p++) pairs->pair_energy[p] = pair_energy[p];
         }
-        free(array[i]); 
     }
-    free(array); 
+
+    free(pair_energy);
+    free(same_spin);
+    return energy_mp2;
 }
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -61,10 +78,10 @@ void free_4d(double ****array, int size_i, int size_j, int size_k)
 // Parameters:
 // - energy: Initial energy (nuclear repulsion or reference energy)
 // - data: One-electron integrals (stored in a flattened 1D array)
-// - integral_array: Four-index two-electron integrals
+// - eri: Symmetry-packed two-electron integrals
 // - mo_num: Total number of molecular orbitals
 // - n_up: Number of occupied orbitals
-double HF_energy(double energy, double *data, double ****integral_array, int mo_num, int n_up)
+double HF_energy(double energy, double *data, const eri_t *eri, int mo_num, int n_up)
 {
     double one_e_term = 0.0; // Contribution from one-electron integrals
     double two_e_term = 0.0; // Contribution from two-electron integrals
@@ -75,16 +92,25 @@ double HF_energy(double energy, double *data, double ****integral_array, int mo_
         one_e_term += data[i * mo_num + i]; // Diagonal elements of the Fock matrix
     }
 
-    // Calculate two-electron term: sum over occupied orbitals
+    // Calculate two-electron term: sum over occupied orbitals, one partial sum per row i
+    double *row_term = malloc((n_up > 0 ? n_up : 1) * sizeof(double));
+    if (row_term == NULL) return NAN;
+
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < n_up; i++)
     {
+        double row = 0.0;
         for (int j = 0; j < n_up; j++)
         {
             // Coulomb - Exchange terms for each pair of occupied orbitals
-            two_e_term += 2 * integral_array[i][j][i][j] - integral_array[i][j][j][i];
+            row += 2 * eri_get(eri, i, j, i, j) - eri_get(eri, i, j, j, i);
         }
+        row_term[i] = row;
     }
 
+    two_e_term = sum_in_order(row_term, n_up);
+    free(row_term);
+
     // Compute final Hartree-Fock energy
     double hf_energy = energy + 2.0 * one_e_term + two_e_term;
 
@@ -95,43 +121,374 @@ double HF_energy(double energy, double *data, double ****integral_array, int mo_
 
 // Function to calculate MP2 (second-order Møller-Plesset) energy correction
 // Parameters:
-// - integral_array: Four-index two-electron integrals
+// - eri: Symmetry-packed two-electron integrals
 // - mo_energy: Molecular orbital energies
 // - n_up: Number of occupied orbitals
 // - mo_num: Total number of molecular orbitals
-double calculate_MP2_energy(double ****integral_array, double *mo_energy, int n_up, int mo_num)
+// - n_frozen: Number of frozen core orbitals, left out of the occupied loops
+// - pairs: Receives the pair energies and spin components (may be NULL)
+double calculate_MP2_energy(const eri_t *eri, double *mo_energy, int n_up, int mo_num, int n_frozen, mp2_pairs_t *pairs)
 {
-    double energy_mp2 = 0.0;
+    // One partial sum per (i,j) pair, the pairs being shared among the threads
+    int n_active = n_up - n_frozen;
+    size_t n_pair = (size_t) n_active * n_active;
+    double *direct = malloc((n_pair > 0 ? n_pair : 1) * sizeof(double));
+    double *exchange = malloc((n_pair > 0 ? n_pair : 1) * sizeof(double));
+    if (direct == NULL || exchange == NULL)
+    {
+        free(direct);
+        free(exchange);
+        return NAN;
+    }
 
-    // Loop over occupied orbitals (i, j) and virtual orbitals (a, b)
-    for (int i = 0; i < n_up; i++)
+    // Loop over active occupied orbitals (i, j) and virtual orbitals (a, b)
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (int i = n_frozen; i < n_up; i++)
     {
-        for (int j = 0; j < n_up; j++)
+        for (int j = n_frozen; j < n_up; j++)
         {
+            double direct_ij = 0.0;
+            double exchange_ij = 0.0;
+
             for (int a = n_up; a < mo_num; a++) // Virtual orbitals start after occupied ones
             {
                 for (int b = n_up; b < mo_num; b++)
                 {
-                    // Calculate MP2 numerator: Includes Coulomb and Exchange terms
-                    double numerator = integral_array[i][j][a][b] * (2.0 * integral_array[i][j][a][b] - integral_array[i][j][b][a]);
+                    // Coulomb <ij|ab> and exchange <ij|ba> integrals
+                    double ijab = eri_get(eri, i, j, a, b);
+                    double ijba = eri_get(eri, i, j, b, a);
 
                     // Calculate MP2 denominator: Energy difference between occupied and virtual orbitals
                     double denominator = mo_energy[i] + mo_energy[j] - mo_energy[a] - mo_energy[b];
 
-                    // Sum MP2 energy correction
-                    energy_mp2 += numerator / denominator;
+                    direct_ij += ijab * ijab / denominator;
+                    exchange_ij += ijab * ijba / denominator;
                 }
             }
+            direct[(i - n_frozen) * n_active + (j - n_frozen)] = direct_ij;
+            exchange[(i - n_frozen) * n_active + (j - n_frozen)] = exchange_ij;
         }
     }
 
+    double energy_mp2 = combine_pairs(direct, exchange, n_active, pairs);
+    free(direct);
+    free(exchange);
+
     return energy_mp2; // Return total MP2 correction
 }
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------
 
+// Function to calculate the Hartree-Fock (HF) energy from the (oo|oo) block
+// Parameters:
+// - energy: Initial energy (nuclear repulsion or reference energy)
+// - data: One-electron integrals (stored in a flattened 1D array)
+// - blocks: Occupied integral blocks
+// - mo_num: Total number of molecular orbitals
+double HF_energy_blocks(double energy, double *data, const eri_blocks_t *blocks, int mo_num)
+{
+    int n_up = blocks->n_occ;
+    double one_e_term = 0.0;
+    double two_e_term = 0.0;
+
+    for (int i = 0; i < n_up; i++)
+    {
+        one_e_term += data[i * mo_num + i];
+    }
+
+    double *row_term = malloc((n_up > 0 ? n_up : 1) * sizeof(double));
+    if (row_term == NULL) return NAN;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_up; i++)
+    {
+        double row = 0.0;
+        for (int j = 0; j < n_up; j++)
+        {
+            row += 2 * blocks_oooo(blocks, i, j, i, j) - blocks_oooo(blocks, i, j, j, i);
+        }
+        row_term[i] = row;
+    }
+
+    two_e_term = sum_in_order(row_term, n_up);
+    free(row_term);
+
+    return energy + 2.0 * one_e_term + two_e_term;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function returning a bound on the MP2 energy of the pairs (i,j) and (j,i) of a screened block
+// With the smallest denominator gap of the pair, |2 <ij|ab>^2 - <ij|ab> <ij|ba>| summed over
+// a,b and divided by the denominators is at most 3 |K_ij|^2 / gap by Cauchy-Schwarz, |K_ij|
+// being the Frobenius norm of the tile (the tile of (j,i) is its transpose, of the same norm).
+// Parameters:
+// - blocks: Screened integral blocks, after blocks_finish
+// - mo_energy: Molecular orbital energies
+// - i, j: Active orbitals (i,j >= n_frozen, row i kept)
+double MP2_pair_bound(const eri_blocks_t *blocks, const double *mo_energy, int i, int j)
+{
+    // Smallest denominator e_a + e_b - e_i - e_j of the pair
+    double virt_min = mo_energy[blocks->n_occ];
+    for (int a = 1; a < blocks->n_virt; a++)
+    {
+        if (mo_energy[blocks->n_occ + a] < virt_min) virt_min = mo_energy[blocks->n_occ + a];
+    }
+    double gap = 2.0 * virt_min - mo_energy[i] - mo_energy[j];
+    if (!(gap > 0.0)) return INFINITY;
+
+    double norm = blocks_tile_norm(blocks, i, j);
+    return ((i == j) ? 3.0 : 6.0) * norm * norm / gap;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to calculate the direct and exchange sums of the pairs of the (ov|ov) block
+// The pairs (i,j) and (j,i) are handled together by a vectorized pair kernel chosen for the
+// CPU at run time (see mp2_kernel.c), by the process keeping the row min(i,j). When the other
+// row is not kept, the exchange tile <ij|ba> is the transpose of <ij|ab>, which holds the same
+// integrals, so the sums do not depend on the slicing. The pairs of the rows not kept are zero.
+// The pairs of a screened block whose bound (MP2_pair_bound) is below the screening threshold
+// are left at zero without reading their tiles, and a tile without integrals reads as zeros.
+// Parameters:
+// - blocks: Occupied integral blocks (all the rows or a slice of them)
+// - mo_energy: Molecular orbital energies
+// - direct, exchange: Receive the sums of the n_active x n_active ordered pairs
+// Returns 0 on success, -1 if memory runs out (the sums are then incomplete).
+int MP2_pair_sums_blocks(const eri_blocks_t *blocks, double *mo_energy, double *direct, double *exchange)
+{
+    int n_frozen = blocks->n_frozen;
+    int n_active = blocks->n_occ - n_frozen;
+    int n_virt = blocks->n_virt;
+    const double *virt_energy = mo_energy + blocks->n_occ;
+    mp2_pair_kernel_t kernel = mp2_kernel_select();
+    int sliced = (blocks->row_stride > 1);
+    int screened = (blocks->screening > 0.0);
+
+    // Unordered pairs i <= j of the rows kept, flattened so that the threads share them evenly
+    int n_pair = 0;
+    for (int i = 0; i < n_active; i++)
+    {
+        if (blocks_has_row(blocks, n_frozen + i)) n_pair += n_active - i;
+    }
+    int *pair_i = malloc((n_pair > 0 ? n_pair : 1) * sizeof(int));
+    int *pair_j = malloc((n_pair > 0 ? n_pair : 1) * sizeof(int));
+    if (pair_i == NULL || pair_j == NULL)
+    {
+        free(pair_i);
+        free(pair_j);
+        return -1;
+    }
+
+    int n_p = 0;
+    for (int i = 0; i < n_active; i++)
+    {
+        if (!blocks_has_row(blocks, n_frozen + i)) continue;
+        for (int j = i; j < n_active; j++)
+        {
+            if (screened && MP2_pair_bound(blocks, mo_energy, n_frozen + i, n_frozen + j) < blocks->screening) continue;
+            pair_i[n_p] = i;
+            pair_j[n_p] = j;
+            n_p++;
+        }
+    }
+    n_pair = n_p;
+
+    memset(direct, 0, (size_t) n_active * n_active * sizeof(double));
+    memset(exchange, 0, (size_t) n_active * n_active * sizeof(double));
+
+    // A thread without its buffers still takes part in the loop, but skips its pairs
+    int failed = 0;
+    #pragma omp parallel
+    {
+        // Single and mixed precision tiles are widened into buffers of the thread, the sums stay
+        // in double; a slice also transposes the tiles whose exchange row it does not keep, and
+        // the tiles a screened block has no memory for are zeros
+        int needs_buffer = (blocks->precision != BLOCKS_DOUBLE || sliced || screened);
+        double *buffer_ij = NULL;
+        if (needs_buffer)
+        {
+            buffer_ij = malloc(2 * (size_t) n_virt * n_virt * sizeof(double) + sizeof(double));
+            if (buffer_ij == NULL)
+            {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        double *buffer_ji = (buffer_ij != NULL) ? buffer_ij + (size_t) n_virt * n_virt : NULL;
+
+        #pragma omp for schedule(dynamic)
+        for (int p = 0; p < n_pair; p++)
+        {
+            if (needs_buffer && buffer_ij == NULL) continue;
+            int i = pair_i[p];
+            int j = pair_j[p];
+            int ij = i * n_active + j;
+            int ji = j * n_active + i;
+
+            // Tile <ij|ab>; the tile <ji|ab> = <ij|ba> is its pre-transposed exchange block
+            const double *tile_ij = blocks_tile_double(blocks, n_frozen + i, n_frozen + j, buffer_ij);
+            if (tile_ij == NULL)
+            {
+                memset(buffer_ij, 0, (size_t) n_virt * n_virt * sizeof(double));
+                tile_ij = buffer_ij;
+            }
+            const double *tile_ji;
+            if (blocks_has_row(blocks, n_frozen + j))
+            {
+                tile_ji = blocks_tile_double(blocks, n_frozen + j, n_frozen + i, buffer_ji);
+                if (tile_ji == NULL)
+                {
+                    memset(buffer_ji, 0, (size_t) n_virt * n_virt * sizeof(double));
+                    tile_ji = buffer_ji;
+                }
+            }
+            else
+            {
+                for (int a = 0; a < n_virt; a++)
+                {
+                    for (int b = 0; b < n_virt; b++)
+                    {
+                        buffer_ji[a * n_virt + b] = tile_ij[b * n_virt + a];
+                    }
+                }
+                tile_ji = buffer_ji;
+            }
+
+            kernel(tile_ij, tile_ji, virt_energy, mo_energy[n_frozen + i] + mo_energy[n_frozen + j], n_virt,
+                   &direct[ij], &exchange[ij]);
+
+            // The pair (j,i) has the same sums
+            direct[ji] = direct[ij];
+            exchange[ji] = exchange[ij];
+        }
+
+        free(buffer_ij);
+    }
+
+    free(pair_i);
+    free(pair_j);
+    return failed ? -1 : 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to calculate the MP2 energy correction from the (ov|ov) block
+// Parameters:
+// - blocks: Occupied integral blocks
+// - mo_energy: Molecular orbital energies
+// - pairs: Receives the pair energies and spin components (may be NULL)
+double calculate_MP2_energy_blocks(const eri_blocks_t *blocks, double *mo_energy, mp2_pairs_t *pairs)
+{
+    int n_active = blocks->n_occ - blocks->n_frozen;
+    size_t n_ordered = (size_t) n_active * n_active;
+    double *direct = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+    double *exchange = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+    double energy_mp2 = NAN;
+    if (direct != NULL && exchange != NULL && MP2_pair_sums_blocks(blocks, mo_energy, direct, exchange) == 0)
+        energy_mp2 = combine_pairs(direct, exchange, n_active, pairs);
+    free(direct);
+    free(exchange);
+
+    return energy_mp2;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to calculate the MP2 energy correction from the Cholesky vectors
+// The tile <ij|ab> of each pair is assembled from the vectors of i and j in a buffer of
+// the thread, transposed into <ij|ba>, and passed to the same pair kernel as the blocks.
+// Parameters:
+// - cholesky: Cholesky decomposition of the (ia|jb) integrals
+// - mo_energy: Molecular orbital energies
+// - pairs: Receives the pair energies and spin components (may be NULL)
+double calculate_MP2_energy_cholesky(const eri_cholesky_t *cholesky, double *mo_energy, mp2_pairs_t *pairs)
+{
+    int n_frozen = cholesky->n_frozen;
+    int n_active = cholesky->n_occ - n_frozen;
+    int n_virt = cholesky->n_virt;
+    const double *virt_energy = mo_energy + cholesky->n_occ;
+    mp2_pair_kernel_t kernel = mp2_kernel_select();
+
+    int n_pair = n_active * (n_active + 1) / 2;
+    size_t n_ordered = (size_t) n_active * n_active;
+    double *direct = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+    double *exchange = malloc((n_ordered > 0 ? n_ordered : 1) * sizeof(double));
+    int *pair_i = malloc((n_pair > 0 ? n_pair : 1) * sizeof(int));
+    int *pair_j = malloc((n_pair > 0 ? n_pair : 1) * sizeof(int));
+    if (direct == NULL || exchange == NULL || pair_i == NULL || pair_j == NULL)
+    {
+        free(direct);
+        free(exchange);
+        free(pair_i);
+        free(pair_j);
+        return NAN;
+    }
+
+    int n_p = 0;
+    for (int i = 0; i < n_active; i++)
+    {
+        for (int j = i; j < n_active; j++)
+        {
+            pair_i[n_p] = i;
+            pair_j[n_p] = j;
+            n_p++;
+        }
+    }
+
+    // A thread without its tiles still takes part in the loop, but skips its pairs
+    int failed = 0;
+    #pragma omp parallel
+    {
+        double *tile_ij = malloc(2 * (size_t) n_virt * n_virt * sizeof(double) + sizeof(double));
+        if (tile_ij == NULL)
+        {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        double *tile_ji = (tile_ij != NULL) ? tile_ij + (size_t) n_virt * n_virt : NULL;
+
+        #pragma omp for schedule(dynamic)
+        for (int p = 0; p < n_pair; p++)
+        {
+            if (tile_ij == NULL) continue;
+            int i = pair_i[p];
+            int j = pair_j[p];
+            int ij = i * n_active + j;
+            int ji = j * n_active + i;
+
+            cholesky_tile(cholesky, n_frozen + i, n_frozen + j, tile_ij);
+            for (int a = 0; a < n_virt; a++)
+            {
+                for (int b = 0; b < n_virt; b++)
+                {
+                    tile_ji[b * n_virt + a] = tile_ij[a * n_virt + b];
+                }
+            }
+
+            kernel(tile_ij, tile_ji, virt_energy, mo_energy[n_frozen + i] + mo_energy[n_frozen + j],
+                   n_virt, &direct[ij], &exchange[ij]);
+            direct[ji] = direct[ij];
+            exchange[ji] = exchange[ij];
+        }
+
+        free(tile_ij);
+    }
+
+    double energy_mp2 = failed ? NAN : combine_pairs(direct, exchange, n_active, pairs);
+    free(direct);
+    free(exchange);
+    free(pair_i);
+    free(pair_j);
+
+    return energy_mp2;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------
+
 // Function to create the outfile
-void create_output_file(const char *output_filename, const char *input_filename, double energy, int n_up, int mo_num, double hf_energy, double mp2_energy) 
+void create_output_file(const char *output_filename, const char *input_filename, double energy, int n_up, int mo_num, double hf_energy, double mp2_energy,
+                        const mp2_profile_t *profile)
 {
     FILE *output_file = fopen(output_filename, "w");
     if (output_file == NULL) 
@@ -161,6 +518,55 @@ void create_output_file(const char *output_filename, const char *input_filename,
     fprintf(output_file, "---------------------------------------------\n");
     fprintf(output_file, "Calculation completed successfully!\n");
 
+    // The timings come after the results, the lines above stay comparable with older reports
+    if (profile != NULL)
+    {
+        fprintf(output_file, "\n---------------------------------------------\n");
+        profile_print(output_file, profile);
+    }
+
     fclose(output_file);
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Function to write the pair energies and spin components of an MP2 calculation
+// Every unordered pair is listed once, with the energies of (i,j) and (j,i) added
+// together, so that the pair energies sum to the MP2 energy. Orbitals count from 1.
+// Parameters:
+// - pairs_filename: File to write
+// - input_filename: TREXIO file the energies come from
+// - n_frozen: Number of frozen core orbitals
+// - pairs: Pair energies and spin components
+// - mp2_energy: Total MP2 energy
+void write_pair_energies(const char *pairs_filename, const char *input_filename, int n_frozen, const mp2_pairs_t *pairs, double mp2_energy)
+{
+    FILE *pairs_file = fopen(pairs_filename, "w");
+    if (pairs_file == NULL)
+    {
+        printf("Error: Unable to create pair energy file %s\n", pairs_filename);
+        return;
+    }
+
+    int n_active = pairs->n_active;
+
+    fprintf(pairs_file, "MP2 pair energies of %s\n\n", input_filename);
+    fprintf(pairs_file, "  Frozen Core Orbitals         : %12d\n", n_frozen);
+    fprintf(pairs_file, "  Correlated Occupied Orbitals : %12d\n", n_active);
+    fprintf(pairs_file, "  Same-Spin MP2 Energy         : %15.9f\n", pairs->same_spin);
+    fprintf(pairs_file, "  Opposite-Spin MP2 Energy     : %15.9f\n", pairs->opposite_spin);
+    fprintf(pairs_file, "  MP2 Energy                   : %15.9f\n\n", mp2_energy);
+    fprintf(pairs_file, "%6s %6s %18s\n", "i", "j", "e_ij");
+
+    for (int i = 0; i < n_active; i++)
+    {
+        for (int j = i; j < n_active; j++)
+        {
+            double energy = pairs->pair_energy[i * n_active + j];
+            if (j != i) energy += pairs->pair_energy[j * n_active + i];
+            fprintf(pairs_file, "%6d %6d %18.12f\n", n_frozen + i + 1, n_frozen + j + 1, energy);
+        }
+    }
+
+    fclose(pairs_file);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------
@@ -3,12 +3,19 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "eri.h"
+#include "blocks.h"
+#include "cholesky.h"
+#include "profile.h"
 
-//Functon to allocate the memorey 
-double ****malloc_4d(int size_i, int size_j, int size_k, int size_l);
-
-//Function to free the memory
-void free_4d(double ****array, int size_i, int size_j, int size_k);
+// Pair energies and spin components of an MP2 calculation
+typedef struct
+{
+    int n_active;               // Number of correlated occupied orbitals
+    double same_spin;           // Same-spin part of the MP2 energy
+    double opposite_spin;       // Opposite-spin part of the MP2 energy
+    double *pair_energy;        // n_active x n_active pair energies e_ij, filled if not NULL
+} mp2_pairs_t;
 
 //Function reading nuclear repulsion. 
 trexio_exit_code trexio_read_nucleus_repulsion(trexio_t* const trexio_file, double* const energy);
@@ -31,12 +38,37 @@ trexio_exit_code trexio_read_mo_2e_int_eri(trexio_t* const file,const int64_t of
 //Function reading the molecular energy
 trexio_exit_code trexio_read_mo_energy(trexio_t* const file,double* const mo_energy);
 
+// The energy functions below return NAN if memory runs out
+
 // Function to calculate the Hartree-Fock energy
-double HF_energy(double energy, double *data, double ****integral_array, int mo_num, int n_up);
+double HF_energy(double energy, double *data, const eri_t *eri, int mo_num, int n_up);
 
 // Function to calculate MP2 energy correction
-double calculate_MP2_energy(double ****integral_array, double *mo_energy, int n_up,int mo_num);
+double calculate_MP2_energy(const eri_t *eri, double *mo_energy, int n_up, int mo_num, int n_frozen, mp2_pairs_t *pairs);
+
+// Function to calculate the Hartree-Fock energy from the (oo|oo) block
+double HF_energy_blocks(double energy, double *data, const eri_blocks_t *blocks, int mo_num);
+
+// Function to calculate the MP2 energy from the direct and exchange sums of the ordered pairs
+double combine_pairs(const double *direct, const double *exchange, int n_active, mp2_pairs_t *pairs);
+
+// Function returning a bound on the MP2 energy of the pairs (i,j) and (j,i) of a screened (ov|ov) block
+double MP2_pair_bound(const eri_blocks_t *blocks, const double *mo_energy, int i, int j);
+
+// Function to calculate the direct and exchange sums of the pairs of the rows kept in the (ov|ov) block.
+// Returns 0 on success, -1 if memory runs out.
+int MP2_pair_sums_blocks(const eri_blocks_t *blocks, double *mo_energy, double *direct, double *exchange);
+
+// Function to calculate MP2 energy correction from the (ov|ov) block
+double calculate_MP2_energy_blocks(const eri_blocks_t *blocks, double *mo_energy, mp2_pairs_t *pairs);
+
+// Function to calculate MP2 energy correction from the Cholesky vectors of the (ov|ov) block
+double calculate_MP2_energy_cholesky(const eri_cholesky_t *cholesky, double *mo_energy, mp2_pairs_t *pairs);
+
+//Funtion to write output file (the performance section is left out when profile is NULL)
+void create_output_file(const char *output_filename, const char *input_filename, double energy, int n_up, int mo_num, double hf_energy, double mp2_energy,
+                        const mp2_profile_t *profile);
 
-//Funtion to write output file
-void create_output_file(const char *output_filename, const char *input_filename, double energy, int n_up, int mo_num, double hf_energy, double mp2_energy);
+// Function to write the pair energies and spin components of an MP2 calculation
+void write_pair_energies(const char *pairs_filename, const char *input_filename, int n_frozen, const mp2_pairs_t *pairs, double mp2_energy);
 #endif
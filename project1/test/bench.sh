@@ -0,0 +1,90 @@
+#!/bin/sh
+# Repeated timing runs of mp2_energy
+# Usage: test/bench.sh [mp2_energy options] [files.h5]     (run from project1/, see "make bench")
+#
+# Each input (default data/*.h5) is run BENCH_REPEAT times in a scratch directory. The
+# per-phase timings, peak memory and rates of the <input>.profile.json files, and the wall
+# time of the whole process, are summarised as median, standard deviation and minimum.
+# With BENCH_SIZES="60 100 140", synthetic systems of these mo_num (n_up = mo_num / 5) are
+# generated with mp2_synth and benchmarked too, for scaling curves.
+# With BENCH_CSV=file, the summary is also appended to file, one row per metric.
+
+PROGRAM=${PROGRAM:-./mp2_energy}
+SYNTH=${SYNTH:-./mp2_synth}
+REPEAT=${BENCH_REPEAT:-5}
+
+if [ ! -x "$PROGRAM" ]; then
+    echo "Error: $PROGRAM not found, run make first."
+    exit 1
+fi
+
+scratch=$(mktemp -d) || exit 1
+trap 'rm -rf "$scratch"' EXIT
+
+# Options go to mp2_energy, the other arguments are inputs
+options=""
+inputs=""
+for argument in "$@"; do
+    case "$argument" in
+        *.h5) inputs="$inputs $argument" ;;
+        *)    options="$options $argument" ;;
+    esac
+done
+options=${options# }
+[ -z "$inputs" ] && [ -z "$BENCH_SIZES" ] && inputs=$(ls data/*.h5)
+
+for input in $inputs; do
+    cp "$input" "$scratch/" || exit 1
+done
+for size in $BENCH_SIZES; do
+    if [ ! -x "$SYNTH" ]; then
+        echo "Error: $SYNTH not found, run make synth first."
+        exit 1
+    fi
+    "$SYNTH" "$scratch/synth$size.h5" "$size" $((size / 5)) > /dev/null || exit 1
+    inputs="$inputs synth$size.h5"
+done
+
+version=$(git describe --always --dirty 2>/dev/null || echo unknown)
+echo "mp2_energy $version, options:${options:- none}, $REPEAT runs"
+printf "%-12s %-22s %14s %14s %14s\n" "input" "metric" "median" "stddev" "min"
+
+for input in $inputs; do
+    name=$(basename "$input" .h5)
+    samples=$scratch/$name.samples
+    : > "$samples"
+
+    run=0
+    while [ $run -lt $REPEAT ]; do
+        start=$(date +%s.%N)
+        if ! $PROGRAM $options "$scratch/$name.h5" > "$scratch/log" 2>&1; then
+            echo "Error: $PROGRAM failed on $name"
+            cat "$scratch/log"
+            exit 1
+        fi
+        end=$(date +%s.%N)
+        echo "process_time $(awk -v a="$start" -v b="$end" 'BEGIN { printf "%.6f", b - a }')" >> "$samples"
+
+        # One "key value" line per measured number of the JSON file (not the dimensions)
+        sed 's/"phases": //' "$scratch/$name.profile.json" | tr -d '{}' | tr ',' '\n' |
+            sed -n 's/^ *"\([a-z_0-9]*\)": *\([-0-9.e+]*\) *$/\1 \2/p' |
+            grep -v -E '^(n_up|mo_num|n_frozen|threads|read_depth|laplace_points|screening|tiles_total) ' >> "$samples"
+        run=$((run + 1))
+    done
+
+    sort -k1,1 -k2,2g "$samples" | awk -v name="$name" -v version="$version" -v csv="$BENCH_CSV" -v options="$options" '
+        function flush()
+        {
+            if (n == 0) return
+            median = (n % 2) ? v[(n + 1) / 2] : 0.5 * (v[n / 2] + v[n / 2 + 1])
+            mean = sum / n
+            var = (n > 1) ? (sum2 - n * mean * mean) / (n - 1) : 0
+            stddev = (var > 0) ? sqrt(var) : 0
+            printf "%-12s %-22s %14.6g %14.6g %14.6g\n", name, key, median, stddev, v[1]
+            if (csv != "") printf "%s,%s,%s,%s,%d,%.6g,%.6g,%.6g\n", version, options, name, key, n, median, stddev, v[1] >> csv
+            n = 0; sum = 0; sum2 = 0
+        }
+        $1 != key { flush(); key = $1 }
+        { v[++n] = $2; sum += $2; sum2 += $2 * $2 }
+        END { flush() }'
+done
@@ -0,0 +1,83 @@
+#!/bin/sh
+# Check of the integral cache: a warm run maps the cache without reading its input
+# Usage: test/cache.sh [mp2_energy options]        (run from project1/, see "make cache_check")
+#
+# A copy of data/$CACHE_INPUT.h5 is run cold with -c, which writes the cache. Its bytes are then
+# overwritten in place with zeros (same inode and size) and its modification time restored, so
+# that its key is unchanged while its contents can no longer be read as a trexio file. A warm run
+# must still report the energies of the cold one from the cache, which it could not do had it
+# read the input; with -V the contents are hashed, the cache rejected and the run must fail.
+
+PROGRAM=${PROGRAM:-./mp2_energy}
+MODES=${CHECK_MODES:-"blocks full"}
+NAME=${CACHE_INPUT:-h2o}
+
+if [ ! -x "$PROGRAM" ]; then
+    echo "Error: $PROGRAM not found, run make first."
+    exit 1
+fi
+if [ ! -f "data/$NAME.h5" ]; then
+    echo "SKIP  $NAME (no data/$NAME.h5)"
+    exit 0
+fi
+
+scratch=$(mktemp -d) || exit 1
+trap 'rm -rf "$scratch"' EXIT
+
+# Value of a line "  <label> : <value>" of a report
+field()
+{
+    grep "$2" "$1" | head -n 1 | awk -F: '{ gsub(/ /, "", $2); print $2 }'
+}
+
+n_pass=0
+n_fail=0
+
+for mode in $MODES; do
+    input=$scratch/$NAME.h5
+    report=$scratch/$NAME.txt
+    rm -rf "$scratch/cache"
+    mkdir "$scratch/cache"
+    cp "data/$NAME.h5" "$input"
+
+    status=PASS
+    details=""
+    if ! "$PROGRAM" -l "$mode" -c "$scratch/cache" "$@" "$input" > "$scratch/log" 2>&1 || [ ! -f "$report" ]; then
+        status=FAIL
+        details="
+      cold run failed"
+    fi
+    cold=$(field "$report" "Total Energy")
+
+    # Same key, unreadable contents
+    touch -r "$input" "$scratch/time"
+    size=$(wc -c < "$input")
+    head -c "$size" /dev/zero | dd of="$input" conv=notrunc 2> /dev/null
+    touch -r "$scratch/time" "$input"
+
+    rm -f "$report"
+    if [ $status = PASS ]; then
+        if ! "$PROGRAM" -l "$mode" -c "$scratch/cache" "$@" "$input" > "$scratch/log" 2>&1 ||
+           ! grep -q ", cached)" "$scratch/log" || [ "$(field "$report" "Total Energy")" != "$cold" ]; then
+            status=FAIL
+            details="
+      warm run did not use the cache alone:
+$(sed 's/^/      /' "$scratch/log")"
+        elif "$PROGRAM" -l "$mode" -c "$scratch/cache" -V "$@" "$input" > "$scratch/log" 2>&1; then
+            status=FAIL
+            details="
+      -V accepted a cache of other contents"
+        fi
+    fi
+
+    if [ $status = PASS ]; then
+        n_pass=$((n_pass + 1))
+        echo "PASS  $NAME [$mode]"
+    else
+        n_fail=$((n_fail + 1))
+        echo "FAIL  $NAME [$mode]$details"
+    fi
+done
+
+echo "$n_pass passed, $n_fail failed"
+[ $n_fail -eq 0 ]
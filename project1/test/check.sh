@@ -0,0 +1,81 @@
+#!/bin/sh
+# Regression check of mp2_energy against the reference reports of test/
+# Usage: test/check.sh [mp2_energy options]        (run from project1/, see "make check")
+#
+# Every data/*.h5 with a reference test/<name>.txt is run with each load mode, in a
+# scratch directory so that data/ is left untouched, and the energies of the report are
+# compared with the reference. References without an input file are listed as skipped.
+# Tolerances (hartree): CHECK_TOL for the exact modes, CHECK_TOL_CHOLESKY for -l cholesky.
+
+PROGRAM=${PROGRAM:-./mp2_energy}
+MODES=${CHECK_MODES:-"blocks full cholesky"}
+TOL=${CHECK_TOL:-2e-6}
+TOL_CHOLESKY=${CHECK_TOL_CHOLESKY:-1e-5}
+
+if [ ! -x "$PROGRAM" ]; then
+    echo "Error: $PROGRAM not found, run make first."
+    exit 1
+fi
+
+scratch=$(mktemp -d) || exit 1
+trap 'rm -rf "$scratch"' EXIT
+
+# Value of a line "  <label> : <value>" of a report
+field()
+{
+    grep "$2" "$1" | head -n 1 | awk -F: '{ gsub(/ /, "", $2); print $2 }'
+}
+
+n_pass=0
+n_fail=0
+n_skip=0
+
+for reference in test/*.txt; do
+    name=$(basename "$reference" .txt)
+    input=data/$name.h5
+    if [ ! -f "$input" ]; then
+        echo "SKIP  $name (no $input)"
+        n_skip=$((n_skip + 1))
+        continue
+    fi
+
+    cp "$input" "$scratch/$name.h5"
+    for mode in $MODES; do
+        tol=$TOL
+        [ "$mode" = cholesky ] && tol=$TOL_CHOLESKY
+        report=$scratch/$name.txt
+        rm -f "$report"
+
+        if ! "$PROGRAM" -l "$mode" "$@" "$scratch/$name.h5" > "$scratch/log" 2>&1 || [ ! -f "$report" ]; then
+            echo "FAIL  $name [$mode]: the program failed"
+            sed 's/^/      /' "$scratch/log"
+            n_fail=$((n_fail + 1))
+            continue
+        fi
+
+        status=PASS
+        details=""
+        for label in "Nuclear Repulsion Energy" "Number of Occupied Orbitals" "Number of Molecular Orbitals" \
+                     "Hartree-Fock Energy" "MP2 Energy" "Total Energy"; do
+            expected=$(field "$reference" "$label")
+            computed=$(field "$report" "$label")
+            if ! awk -v a="$expected" -v b="$computed" -v t="$tol" \
+                     'BEGIN { d = a - b; if (d < 0) d = -d; exit !(a != "" && b != "" && d <= t) }'; then
+                status=FAIL
+                details="$details
+      $label: expected $expected, got $computed"
+            fi
+        done
+
+        if [ $status = PASS ]; then
+            n_pass=$((n_pass + 1))
+            echo "PASS  $name [$mode]"
+        else
+            n_fail=$((n_fail + 1))
+            echo "FAIL  $name [$mode] (tolerance $tol)$details"
+        fi
+    done
+done
+
+echo "$n_pass passed, $n_fail failed, $n_skip skipped"
+[ $n_fail -eq 0 ]
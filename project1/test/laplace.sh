@@ -0,0 +1,72 @@
+#!/bin/sh
+# Energy deviation of the Laplace quadrature of the MP2 denominators from the exact Cholesky path
+# Usage: test/laplace.sh [mp2_energy options] [files.h5]    (run from project1/, see "make laplace")
+#
+# Each input (default data/*.h5, plus the synthetic systems of BENCH_SIZES as in bench.sh)
+# is run with -l cholesky, then with -L and each number of points of LAPLACE_POINTS. The MP2
+# energy of the summary file is compared with the exact run (in microhartree), next to the
+# error bound and the MP2 time of the performance report, to choose the points of each system.
+
+PROGRAM=${PROGRAM:-./mp2_energy}
+SYNTH=${SYNTH:-./mp2_synth}
+LAPLACE_POINTS=${LAPLACE_POINTS:-"2 4 6 8 12"}
+
+if [ ! -x "$PROGRAM" ]; then
+    echo "Error: $PROGRAM not found, run make first."
+    exit 1
+fi
+
+scratch=$(mktemp -d) || exit 1
+trap 'rm -rf "$scratch"' EXIT
+
+options=""
+inputs=""
+for argument in "$@"; do
+    case "$argument" in
+        *.h5) inputs="$inputs $argument" ;;
+        *)    options="$options $argument" ;;
+    esac
+done
+[ -z "$inputs" ] && [ -z "$BENCH_SIZES" ] && inputs=$(ls data/*.h5)
+
+for input in $inputs; do
+    cp "$input" "$scratch/" || exit 1
+done
+for size in $BENCH_SIZES; do
+    if [ ! -x "$SYNTH" ]; then
+        echo "Error: $SYNTH not found, run make synth first."
+        exit 1
+    fi
+    "$SYNTH" "$scratch/synth$size.h5" "$size" $((size / 5)) > /dev/null || exit 1
+    inputs="$inputs synth$size.h5"
+done
+
+# Number "key": value of a profile file
+json_value()
+{
+    tr ',{}' '\n\n\n' < "$1" | sed -n "s/^ *\"$2\": *\([-0-9.e+]*\) *$/\1/p"
+}
+
+printf "%-12s %-8s %16s %16s %12s\n" "input" "points" "MP2 dev (uEh)" "bound (uEh)" "mp2 (s)"
+
+for input in $inputs; do
+    name=$(basename "$input" .h5)
+    for points in exact $LAPLACE_POINTS; do
+        laplace=""
+        [ $points = exact ] || laplace="-L $points"
+        if ! $PROGRAM $options -l cholesky $laplace -o "$scratch/$points.csv" "$scratch/$name.h5" > "$scratch/log" 2>&1; then
+            echo "Error: $PROGRAM -L $points failed on $name"
+            cat "$scratch/log"
+            exit 1
+        fi
+        energy=$(sed -n 2p "$scratch/$points.csv" | cut -d, -f8)
+        [ $points = exact ] && reference=$energy
+        bound=$(json_value "$scratch/$name.profile.json" laplace_bound)
+        mp2_time=$(json_value "$scratch/$name.profile.json" mp2)
+
+        awk -v name="$name" -v points=$points -v e="$energy" -v r="$reference" -v b="$bound" -v t="$mp2_time" '
+            BEGIN {
+                printf "%-12s %-8s %16.4f %16.4f %12.6f\n", name, points, 1e6 * (e - r), 1e6 * b, t
+            }'
+    done
+done
@@ -0,0 +1,71 @@
+#!/bin/sh
+# Energy deviation of the single and mixed precision storage from the all-double path
+# Usage: test/precision.sh [mp2_energy options] [files.h5]    (run from project1/, see "make precision")
+#
+# Each input (default data/*.h5, plus the synthetic systems of BENCH_SIZES as in bench.sh)
+# is run with -P double, float and mixed. The HF and MP2 energies of the summary file are
+# compared with the double run (in microhartree), next to the peak memory and the MP2 time
+# of the performance report, to choose the storage of each system.
+
+PROGRAM=${PROGRAM:-./mp2_energy}
+SYNTH=${SYNTH:-./mp2_synth}
+
+if [ ! -x "$PROGRAM" ]; then
+    echo "Error: $PROGRAM not found, run make first."
+    exit 1
+fi
+
+scratch=$(mktemp -d) || exit 1
+trap 'rm -rf "$scratch"' EXIT
+
+options=""
+inputs=""
+for argument in "$@"; do
+    case "$argument" in
+        *.h5) inputs="$inputs $argument" ;;
+        *)    options="$options $argument" ;;
+    esac
+done
+[ -z "$inputs" ] && [ -z "$BENCH_SIZES" ] && inputs=$(ls data/*.h5)
+
+for input in $inputs; do
+    cp "$input" "$scratch/" || exit 1
+done
+for size in $BENCH_SIZES; do
+    if [ ! -x "$SYNTH" ]; then
+        echo "Error: $SYNTH not found, run make synth first."
+        exit 1
+    fi
+    "$SYNTH" "$scratch/synth$size.h5" "$size" $((size / 5)) > /dev/null || exit 1
+    inputs="$inputs synth$size.h5"
+done
+
+# Number "key": value of a profile file
+json_value()
+{
+    tr ',{}' '\n\n\n' < "$1" | sed -n "s/^ *\"$2\": *\([-0-9.e+]*\) *$/\1/p"
+}
+
+printf "%-12s %-8s %16s %16s %12s %12s\n" "input" "storage" "HF dev (uEh)" "MP2 dev (uEh)" "peak (MB)" "mp2 (s)"
+
+for input in $inputs; do
+    name=$(basename "$input" .h5)
+    for precision in double float mixed; do
+        if ! $PROGRAM $options -P $precision -o "$scratch/$precision.csv" "$scratch/$name.h5" > "$scratch/log" 2>&1; then
+            echo "Error: $PROGRAM -P $precision failed on $name"
+            cat "$scratch/log"
+            exit 1
+        fi
+        energies=$(sed -n 2p "$scratch/$precision.csv" | cut -d, -f7,8)
+        [ $precision = double ] && reference=$energies
+        peak=$(json_value "$scratch/$name.profile.json" peak_rss_kb)
+        mp2_time=$(json_value "$scratch/$name.profile.json" mp2)
+
+        awk -v name="$name" -v precision=$precision -v e="$energies" -v r="$reference" -v peak="$peak" -v t="$mp2_time" '
+            BEGIN {
+                split(e, x, ","); split(r, y, ",")
+                printf "%-12s %-8s %16.4f %16.4f %12.1f %12.6f\n", name, precision,
+                       1e6 * (x[1] - y[1]), 1e6 * (x[2] - y[2]), peak / 1024, t
+            }'
+    done
+done
@@ -1,8 +1,18 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<string.h>
+#include<math.h>
+#include<unistd.h>
+#ifdef _OPENMP
+#include<omp.h>
+#endif
 #include "utils.h"
 #include "error.h"
+#include "neighbor.h"
+#include "forces.h"
+#include "simulation.h"
+#include "trajectory.h"
+#include "writer.h"
 
 // --------------------------------------------------------------------------------------------- //
 // ********************************** THE MAIN PROGRAM ***************************************** //
@@ -13,10 +23,87 @@ const double epsilon = 0.0661;    // Lennard-Jones epsilon in J/mol
 const double sigma   = 0.3345;    // Lennard-Jones sigma in nm
 const int WRITE_FREQUENCY= 1;     // Frequency of writing trajectory to file
 
-int main()
+// Usage: ./dynamics [-c cutoff] [-s skin] [-n steps] [-k] [-v kernel] [-t threads] [-b] [-q precision] [-f every] [-w slots] [-d newest|oldest] [input.txt]
+// Without a cutoff every pair of atoms interacts.
+// With -c, only the pairs closer than the cutoff interact: they are found in a Verlet neighbor
+// list built from linked cells, with the pairs up to cutoff + skin, which is rebuilt when an atom
+// moved by more than skin/2. The cost of a step then grows linearly with the number of atoms.
+// -k checks the forces and potential energy of every step against the all-pairs kernel.
+// -v picks the force kernel (scalar, avx2, avx512), by default the widest the processor runs.
+// -t sets the number of OpenMP threads of the forces (make omp), OMP_NUM_THREADS by default.
+// -b writes the trajectory in binary (.trj, see trajectory.h) instead of XYZ text; -q does too,
+// with the coordinates rounded to multiples of precision (nm). trj2xyz converts it back.
+// -f writes one frame every that many steps (WRITE_FREQUENCY by default). The frames are written by a background
+// thread from a ring of -w snapshots (8 by default, 0 to write them in the loop); when the ring is
+// full the loop waits for a free slot, or with -d drops the newest or the oldest snapshot.
+int main(int argc, char** argv)
 {
+    double cutoff = 0.0;              // Interaction cutoff (0: all the pairs)
+    double skin = 0.2;                // Extra distance of the neighbor list
+    size_t total_steps = 1000;        // Total number of simulation step
+    int check = 0;                    // Compare with the all-pairs kernel at every step
+    const char* kernel = "auto";      // Force kernel
+    int n_threads = 0;                // Number of threads (0: OMP_NUM_THREADS)
+    int binary = 0;                   // Binary trajectory instead of XYZ
+    double precision = 0.0;           // Quantization of the binary coordinates (0: doubles)
+    size_t write_frequency = WRITE_FREQUENCY;   // Steps between two frames
+    size_t n_slots = 8;               // Snapshots of the writer thread (0: no thread)
+    writer_policy_t policy = WRITER_BLOCK;      // What to do when all the snapshots are taken
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:s:n:kv:t:bq:f:w:d:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': cutoff = atof(optarg); break;
+            case 's': skin = atof(optarg); break;
+            case 'n': total_steps = (size_t) atol(optarg); break;
+            case 'k': check = 1; break;
+            case 'v': kernel = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'b': binary = 1; break;
+            case 'q': binary = 1; precision = atof(optarg); break;
+            case 'f': write_frequency = (size_t) atol(optarg); break;
+            case 'w': n_slots = (size_t) atol(optarg); break;
+            case 'd':
+                if (strcmp(optarg, "newest") == 0) policy = WRITER_DROP_NEWEST;
+                else if (strcmp(optarg, "oldest") == 0) policy = WRITER_DROP_OLDEST;
+                else
+                {
+                    printf("Error: -d takes newest or oldest\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                printf("Usage: %s [-c cutoff] [-s skin] [-n steps] [-k] [-v scalar|avx2|avx512] [-t threads] [-b] [-q precision] [-f every] [-w slots] [-d newest|oldest] [input.txt]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (cutoff < 0.0 || skin < 0.0 || precision < 0.0)
+    {
+        printf("Error: The cutoff, the skin and the precision cannot be negative\n");
+        return EXIT_FAILURE;
+    }
+    if (write_frequency == 0)
+    {
+        printf("Error: The write frequency must be at least 1\n");
+        return EXIT_FAILURE;
+    }
+    if (lj_kernel_select(kernel) != 0)
+    {
+        printf("Error: The force kernel %s is unknown or not supported by this processor\n", kernel);
+        return EXIT_FAILURE;
+    }
+#ifdef _OPENMP
+    if (n_threads > 0) omp_set_num_threads(n_threads);
+    n_threads = omp_get_max_threads();
+#else
+    if (n_threads > 1) printf("Warning: built without OpenMP, running on a single thread (use make omp).\n");
+    n_threads = 1;
+#endif
+
     // Open input file and read the number of atoms
-    const char* input_filename = "data/CH4.txt";
+    const char* input_filename = (optind < argc) ? argv[optind] : "data/CH4.txt";
     FILE* input_file = fopen(input_filename, "r");
     if (input_file == NULL) error_file_open(input_file);
     
@@ -26,21 +113,21 @@ int main()
     char* dot = strrchr(output_file, '.'); 				// Find the last dot in the file name
     if (dot != NULL) 
 	    *dot = '\0'; 					// Remove the extension
-    strcat(output_file, ".xyz"); 					// Append ".xyz"
+    strcat(output_file, binary ? ".trj" : ".xyz"); 			// Append ".xyz" (".trj" in binary)
 				     
 
     size_t Natoms = read_Natoms(input_file);
     if (Natoms == 0) error_read_atoms();
 
-    // Allocate memory for coordinates, masses, symbols, and other arrays
-    double** coord = malloc_2d(Natoms, 3);
-    double* mass = malloc(Natoms * sizeof(double));
+    // Allocate the simulation once: coordinates, velocities (zero), accelerations, masses, the
+    // buffers of the steps and the neighbor list with a cutoff. Then the symbols.
+    double dt = 0.2;               // Time step
+    md_context_t* context = md_context_create(Natoms, dt, sigma, epsilon, cutoff, skin, check);
+    particles_t* particles = &context->particles;
+    neighbor_list_t* neighbors = context->neighbors;
     char** symbols = malloc(Natoms * sizeof(char*));
-    double** distance = malloc_2d(Natoms, Natoms);
-    double** velocity = malloc_2d(Natoms, 3);
-    double** acceleration = malloc_2d(Natoms, 3);
 
-    if (coord == NULL || mass == NULL || distance == NULL || velocity == NULL || acceleration == NULL) {
+    if (symbols == NULL) {
         error_memory_allocation("Allocation error");
         return EXIT_FAILURE;
     }
@@ -56,70 +143,139 @@ int main()
         }
     }
 
-    if (!read_molecule(input_file, Natoms, coord, mass, symbols)) 
+    if (!read_molecule(input_file, particles, symbols)) 
 	    error_read_atoms();
     fclose(input_file);
 
-    // Initialize velocities to zero
-    for (size_t i = 0; i < Natoms; i++)
-        for (size_t j = 0; j < 3; j++)
-            velocity[i][j] = 0.0;
-
-    // Compute initial distances and accelerations
-    compute_distances(Natoms, coord, distance);
-    compute_acc(Natoms, coord, mass, distance, acceleration, sigma, epsilon);
+    // Compute initial accelerations and potential energy (from the neighbor list with a cutoff)
+    double potential = md_context_start(context);
+    double virial_sum = 0.0;
+    double check_force = 0.0, check_force_max = 0.0, check_potential = 0.0;
 
     // Open trajectory file
-    FILE* trajectory_file = fopen(output_file, "w");
-    if (trajectory_file == NULL) 
+    FILE* trajectory_file = NULL;
+    trajectory_writer_t* trajectory_writer = NULL;
+    if (binary)
+        trajectory_writer = trajectory_open_write(output_file, Natoms, symbols, precision);
+    else
+        trajectory_file = fopen(output_file, "w");
+    if (trajectory_file == NULL && trajectory_writer == NULL) 
     {
         printf("Error opening trajectory file");
         return EXIT_FAILURE;
     }
+    async_writer_t* writer = NULL;
+    if (n_slots > 0)
+    {
+        writer = async_writer_create(Natoms, n_slots, policy, trajectory_file, symbols, trajectory_writer);
+        if (writer == NULL) printf("Warning: no writer thread, the frames are written in the loop\n");
+    }
 
     // Simulation parameters
-    double dt = 0.2;               // Time step
-    size_t total_steps = 1000;    // Total number of simulation step
     size_t progress_interval = 50;
     printf("Starting molecular dynamics simulation.........\n"); // Start message
 
+    int write_status = 0;             // -1 once a frame could not be written: the run stops
     // Molecular dynamics simulation loop
     for (size_t step = 0; step < total_steps; step++) 
     {
         // Compute kinetic, potential, and total energies
-        double kinetic   = kinetic_energy(Natoms, velocity, mass);
-        double potential = potential_energy(epsilon, sigma, Natoms, distance);
+        // (the potential energy and virial come with the forces of the current positions)
+        double kinetic   = kinetic_energy(particles);
         double total     = Total_energy(potential, kinetic);
+        virial_sum += context->virial;
+
+        // Deviation of the cutoff forces and energy from those of all the pairs
+        if (check && neighbors != NULL)
+        {
+            double deviation = fabs(potential - compute_forces(particles, &context->threads, context->check_ax, context->check_ay, context->check_az,
+                                                                  sigma, epsilon, NULL));
+            if (deviation > check_potential) check_potential = deviation;
+            double* acceleration[3] = {particles->ax, particles->ay, particles->az};
+            double* check_acceleration[3] = {context->check_ax, context->check_ay, context->check_az};
+            for (size_t i = 0; i < Natoms; i++)
+            {
+                for (size_t j = 0; j < 3; j++)
+                {
+                    double force = particles->mass[i] * fabs(acceleration[j][i] - check_acceleration[j][i]);
+                    if (force > check_force) check_force = force;
+                    if (particles->mass[i] * fabs(check_acceleration[j][i]) > check_force_max) check_force_max = particles->mass[i] * fabs(check_acceleration[j][i]);
+                }
+            }
+        }
 
-        // Write trajectory every WRITE_FREQUENCY steps
-        if (step % WRITE_FREQUENCY == 0) 
+        // Write trajectory every write_frequency steps (a snapshot for the writer thread)
+        if (step % write_frequency == 0) 
 	{
-            write_trajectory(trajectory_file, Natoms, coord, symbols, kinetic, potential, total, step);
-            
-	    // Update progress bar
-        	if ((step + 1) % progress_interval == 0) 
-		{
-            		printf("#"); // Print one `#` for every 50 steps
-            		fflush(stdout); // Ensure output is printed immediately
-        	}
+            trajectory_frame_t frame = {step, kinetic, potential, total};
+            int status = 0;
+            if (writer != NULL)
+                status = (async_writer_push(writer, particles, &frame) < 0) ? -1 : 0;
+            else if (trajectory_writer != NULL)
+                status = trajectory_write_frame(trajectory_writer, particles, &frame);
+            else
+                write_trajectory(trajectory_file, particles, symbols, kinetic, potential, total, step);
+            if (status != 0)
+            {
+                write_status = -1;
+                break;
+            }
+        }
+
+        // Update progress bar
+        if ((step + 1) % progress_interval == 0) 
+        {
+            printf("#"); // Print one `#` for every 50 steps
+            fflush(stdout); // Ensure output is printed immediately
         }
 
         // Update positions, velocities, and accelerations using Verlet algorithm
-        verlet_update(Natoms, dt, coord, velocity, acceleration, distance, mass, sigma, epsilon);
+        potential = verlet_update(context);
     }
+    // The frames still queued are written before the end message
+    if (writer != NULL && async_writer_close(writer) != 0) write_status = -1;
     printf("\n\n");
-    printf("Molecular dynamics simulation completed successfully.\n"); // End message
-
-    // Close trajectory file and free allocated memory
-    fclose(trajectory_file);
-    free_2d(coord); 
-    free_2d(distance); 
-    free_2d(velocity); 
-    free_2d(acceleration); 
-    free(mass);
+    if (write_status != 0)
+        printf("Error writing trajectory file: frames were lost\n");
+    else
+    {
+        printf("Molecular dynamics simulation completed successfully.\n"); // End message
+        if (total_steps > 0) printf("Average virial: %.8f J/mol\n", virial_sum / total_steps);
+        printf("Force kernel: %s, %d thread(s)\n", lj_kernel_name(lj_kernel_current()), n_threads);
+        if (neighbors != NULL)
+        {
+            printf("Neighbor list: cutoff %.3f, skin %.3f, %zu pairs in the list, built %zu times\n", cutoff, skin,
+                   neighbors->start[Natoms], neighbors->n_builds);
+            if (check)
+                printf("Check against all pairs: largest force deviation %.3e (largest force %.3e), potential deviation %.3e J/mol\n",
+                       check_force, check_force_max, check_potential);
+        }
+        else if (check)
+            printf("Check against all pairs: nothing to compare without a cutoff (-c)\n");
+        if (writer != NULL)
+            printf("Trajectory writer: %zu slots, %zu frames written, %zu dropped, %zu waits for a free slot\n",
+                   writer->n_slots, writer->n_written, writer->n_dropped, writer->n_waits);
+    }
+
+    // Close trajectory file (the index of the binary one, a failed flush of the text one are
+    // write errors too) and free allocated memory
+    async_writer_free(writer);
+    int close_status = 0;
+    if (trajectory_writer != NULL && trajectory_close_write(trajectory_writer) != 0) close_status = -1;
+    if (trajectory_file != NULL)
+    {
+        if (ferror(trajectory_file)) close_status = -1;
+        if (fclose(trajectory_file) != 0) close_status = -1;
+    }
+    if (close_status != 0 && write_status == 0)
+    {
+        printf("Error writing trajectory file\n");
+        write_status = -1;
+    }
+    md_context_free(context);
     for (size_t i = 0; i < Natoms; i++) free(symbols[i]);
     free(symbols);
 
-    return 0;
+    return (write_status != 0) ? EXIT_FAILURE : 0;
 }
 
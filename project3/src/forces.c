@@ -0,0 +1,667 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "forces.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LJ_HAVE_X86 1
+#else
+#define LJ_HAVE_X86 0
+#endif
+
+// ---------------------------------------------------------------------------------------------//
+//                              THE LENNARD-JONES PAIR TERM                                     //
+// ---------------------------------------------------------------------------------------------//
+
+// Everything the kernels need, with the constants of the potential folded once per call
+typedef struct
+{
+    size_t Natoms;
+    size_t padded;          // Length of the particle arrays
+    const double* x;
+    const double* y;
+    const double* z;
+    const double* inv_mass;
+    double* ax;
+    double* ay;
+    double* az;
+    double sigma2;          // sigma^2
+    double eps4;            // 4 epsilon
+    double eps24;           // 24 epsilon
+    double inv_r2_min;      // 1 / r_min^2: the force is capped at the distance r_min
+    double r2_cut;          // Square of the cutoff (infinite for all the pairs)
+} lj_args_t;
+
+static const double r_min = 0.1;   // Minimum allowed distance to avoid division by zero
+
+// Everything is written with r^2 and 1/r^2: with s6 = (sigma^2/r^2)^3,
+//     V = 4 epsilon (s6^2 - s6),    F_ij / r = 24 epsilon / r^2 (s6 - 2 s6^2),
+// so that the force on i is -(F_ij/r) (r_i - r_j) and the virial -r_ij . F_ij = -(F_ij/r) r^2,
+// without any pow, sqrt or division by the mass. The energy uses the true distance (zero at
+// r = 0) and the force the distance raised to r_min, as the kernel with pow did.
+static inline double lj_scalar(const lj_args_t* a, double r2, double* V)
+{
+    double inv = 1.0 / r2;
+    double s6 = a->sigma2 * inv;
+    s6 = s6 * s6 * s6;
+    if (r2 > 0.0) *V += a->eps4 * (s6 * s6 - s6);
+
+    double inv_f = (inv < a->inv_r2_min) ? inv : a->inv_r2_min;
+    double s6_f = a->sigma2 * inv_f;
+    s6_f = s6_f * s6_f * s6_f;
+    return a->eps24 * inv_f * (s6_f - 2.0 * s6_f * s6_f);
+}
+
+// One pair (i,j), j > i: the force goes to atom j at once and is summed for atom i in fi
+static inline void lj_pair_scalar(const lj_args_t* a, size_t i, size_t j, double* fi, double* V, double* W)
+{
+    double dx = a->x[i] - a->x[j];
+    double dy = a->y[i] - a->y[j];
+    double dz = a->z[i] - a->z[j];
+    double r2 = dx * dx + dy * dy + dz * dz;
+    if (r2 >= a->r2_cut) return;
+
+    double f = lj_scalar(a, r2, V);
+    fi[0] += f * dx;
+    fi[1] += f * dy;
+    fi[2] += f * dz;
+    a->ax[j] += f * dx * a->inv_mass[j];
+    a->ay[j] += f * dy * a->inv_mass[j];
+    a->az[j] += f * dz * a->inv_mass[j];
+    *W -= f * r2;
+}
+
+// The force summed over the partners of atom i, applied with the opposite sign
+static inline void lj_apply_scalar(const lj_args_t* a, size_t i, const double* fi)
+{
+    a->ax[i] -= fi[0] * a->inv_mass[i];
+    a->ay[i] -= fi[1] * a->inv_mass[i];
+    a->az[i] -= fi[2] * a->inv_mass[i];
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                                  THE SCALAR KERNELS                                          //
+// ---------------------------------------------------------------------------------------------//
+
+static double lj_all_scalar(const lj_args_t* a, size_t begin, size_t end, double* W)
+{
+    double V = 0.0;
+    for (size_t i = begin; i < end; i++)
+    {
+        double fi[3] = {0.0, 0.0, 0.0};
+        for (size_t j = i + 1; j < a->Natoms; j++) lj_pair_scalar(a, i, j, fi, &V, W);
+        lj_apply_scalar(a, i, fi);
+    }
+    return V;
+}
+
+static double lj_neighbor_scalar(const lj_args_t* a, const neighbor_list_t* neighbors, size_t begin, size_t end, double* W)
+{
+    double V = 0.0;
+    for (size_t i = begin; i < end; i++)
+    {
+        double fi[3] = {0.0, 0.0, 0.0};
+        for (size_t n = neighbors->start[i]; n < neighbors->start[i + 1]; n++)
+            lj_pair_scalar(a, i, neighbors->list[n], fi, &V, W);
+        lj_apply_scalar(a, i, fi);
+    }
+    return V;
+}
+
+#if LJ_HAVE_X86
+
+// ---------------------------------------------------------------------------------------------//
+//                                  THE AVX2 KERNELS                                            //
+// ---------------------------------------------------------------------------------------------//
+
+// The same pair term on 4 pairs. The lanes outside of the cutoff (or of the atoms) get zero.
+__attribute__((target("avx2,fma")))
+static inline __m256d lj_avx2(const lj_args_t* a, __m256d r2, __m256d valid, __m256d* V)
+{
+    __m256d zero = _mm256_setzero_pd();
+    __m256d inv = _mm256_div_pd(_mm256_set1_pd(1.0), r2);
+    __m256d s6 = _mm256_mul_pd(_mm256_set1_pd(a->sigma2), inv);
+    s6 = _mm256_mul_pd(_mm256_mul_pd(s6, s6), s6);
+    __m256d e = _mm256_mul_pd(_mm256_set1_pd(a->eps4), _mm256_fmsub_pd(s6, s6, s6));
+    __m256d positive = _mm256_and_pd(valid, _mm256_cmp_pd(r2, zero, _CMP_GT_OQ));
+    *V = _mm256_add_pd(*V, _mm256_and_pd(e, positive));
+
+    __m256d inv_f = _mm256_min_pd(inv, _mm256_set1_pd(a->inv_r2_min));
+    __m256d s6_f = _mm256_mul_pd(_mm256_set1_pd(a->sigma2), inv_f);
+    s6_f = _mm256_mul_pd(_mm256_mul_pd(s6_f, s6_f), s6_f);
+    __m256d f = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(a->eps24), inv_f),
+                              _mm256_fnmadd_pd(_mm256_add_pd(s6_f, s6_f), s6_f, s6_f));
+    return _mm256_and_pd(f, valid);
+}
+
+__attribute__((target("avx2,fma")))
+static inline double lj_hsum_avx2(__m256d v)
+{
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+__attribute__((target("avx2,fma")))
+static double lj_all_avx2(const lj_args_t* a, size_t begin, size_t end, double* W)
+{
+    size_t N = a->Natoms;
+    __m256d V4 = _mm256_setzero_pd(), W4 = _mm256_setzero_pd();
+    __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    double V = 0.0;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        __m256d xi = _mm256_set1_pd(a->x[i]), yi = _mm256_set1_pd(a->y[i]), zi = _mm256_set1_pd(a->z[i]);
+        __m256d fx = _mm256_setzero_pd(), fy = _mm256_setzero_pd(), fz = _mm256_setzero_pd();
+        size_t j = i + 1;
+
+        // The partners j come 4 by 4 from the contiguous arrays
+        for (; j + 4 <= N; j += 4)
+        {
+            __m256d dx = _mm256_sub_pd(xi, _mm256_loadu_pd(a->x + j));
+            __m256d dy = _mm256_sub_pd(yi, _mm256_loadu_pd(a->y + j));
+            __m256d dz = _mm256_sub_pd(zi, _mm256_loadu_pd(a->z + j));
+            __m256d r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+
+            __m256d f = lj_avx2(a, r2, all, &V4);
+            __m256d fdx = _mm256_mul_pd(f, dx), fdy = _mm256_mul_pd(f, dy), fdz = _mm256_mul_pd(f, dz);
+            fx = _mm256_add_pd(fx, fdx);
+            fy = _mm256_add_pd(fy, fdy);
+            fz = _mm256_add_pd(fz, fdz);
+            W4 = _mm256_fnmadd_pd(f, r2, W4);
+
+            __m256d inv_mj = _mm256_loadu_pd(a->inv_mass + j);
+            _mm256_storeu_pd(a->ax + j, _mm256_fmadd_pd(fdx, inv_mj, _mm256_loadu_pd(a->ax + j)));
+            _mm256_storeu_pd(a->ay + j, _mm256_fmadd_pd(fdy, inv_mj, _mm256_loadu_pd(a->ay + j)));
+            _mm256_storeu_pd(a->az + j, _mm256_fmadd_pd(fdz, inv_mj, _mm256_loadu_pd(a->az + j)));
+        }
+
+        double fi[3] = {lj_hsum_avx2(fx), lj_hsum_avx2(fy), lj_hsum_avx2(fz)};
+        for (; j < N; j++) lj_pair_scalar(a, i, j, fi, &V, W);
+        lj_apply_scalar(a, i, fi);
+    }
+
+    *W += lj_hsum_avx2(W4);
+    return V + lj_hsum_avx2(V4);
+}
+
+__attribute__((target("avx2,fma")))
+static double lj_neighbor_avx2(const lj_args_t* a, const neighbor_list_t* neighbors, size_t begin, size_t end, double* W)
+{
+    __m256d V4 = _mm256_setzero_pd(), W4 = _mm256_setzero_pd();
+    __m256d r2_cut = _mm256_set1_pd(a->r2_cut);
+    double V = 0.0;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        __m256d xi = _mm256_set1_pd(a->x[i]), yi = _mm256_set1_pd(a->y[i]), zi = _mm256_set1_pd(a->z[i]);
+        __m256d fx = _mm256_setzero_pd(), fy = _mm256_setzero_pd(), fz = _mm256_setzero_pd();
+        size_t n = neighbors->start[i], last = neighbors->start[i + 1];
+
+        // The partners are taken 4 by 4 from the list, loaded lane by lane (the AVX2 gathers are
+        // slower on short lists); they are distinct atoms, so that their accelerations can be
+        // updated lane by lane
+        for (; n + 4 <= last; n += 4)
+        {
+            const size_t* j = neighbors->list + n;
+            __m256d dx = _mm256_sub_pd(xi, _mm256_set_pd(a->x[j[3]], a->x[j[2]], a->x[j[1]], a->x[j[0]]));
+            __m256d dy = _mm256_sub_pd(yi, _mm256_set_pd(a->y[j[3]], a->y[j[2]], a->y[j[1]], a->y[j[0]]));
+            __m256d dz = _mm256_sub_pd(zi, _mm256_set_pd(a->z[j[3]], a->z[j[2]], a->z[j[1]], a->z[j[0]]));
+            __m256d r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+
+            __m256d f = lj_avx2(a, r2, _mm256_cmp_pd(r2, r2_cut, _CMP_LT_OQ), &V4);
+            __m256d inv_mj = _mm256_set_pd(a->inv_mass[j[3]], a->inv_mass[j[2]], a->inv_mass[j[1]], a->inv_mass[j[0]]);
+            __m256d fdx = _mm256_mul_pd(f, dx), fdy = _mm256_mul_pd(f, dy), fdz = _mm256_mul_pd(f, dz);
+            fx = _mm256_add_pd(fx, fdx);
+            fy = _mm256_add_pd(fy, fdy);
+            fz = _mm256_add_pd(fz, fdz);
+            W4 = _mm256_fnmadd_pd(f, r2, W4);
+
+            double ajx[4], ajy[4], ajz[4];
+            _mm256_storeu_pd(ajx, _mm256_mul_pd(fdx, inv_mj));
+            _mm256_storeu_pd(ajy, _mm256_mul_pd(fdy, inv_mj));
+            _mm256_storeu_pd(ajz, _mm256_mul_pd(fdz, inv_mj));
+            for (int k = 0; k < 4; k++)
+            {
+                a->ax[j[k]] += ajx[k];
+                a->ay[j[k]] += ajy[k];
+                a->az[j[k]] += ajz[k];
+            }
+        }
+
+        double fi[3] = {lj_hsum_avx2(fx), lj_hsum_avx2(fy), lj_hsum_avx2(fz)};
+        for (; n < last; n++) lj_pair_scalar(a, i, neighbors->list[n], fi, &V, W);
+        lj_apply_scalar(a, i, fi);
+    }
+
+    *W += lj_hsum_avx2(W4);
+    return V + lj_hsum_avx2(V4);
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                                  THE AVX-512 KERNELS                                         //
+// ---------------------------------------------------------------------------------------------//
+
+// The same pair term on 8 pairs; the lanes out of mask get zero
+__attribute__((target("avx512f")))
+static inline __m512d lj_avx512(const lj_args_t* a, __m512d r2, __mmask8 mask, __m512d* V)
+{
+    __m512d inv = _mm512_div_pd(_mm512_set1_pd(1.0), r2);
+    __m512d s6 = _mm512_mul_pd(_mm512_set1_pd(a->sigma2), inv);
+    s6 = _mm512_mul_pd(_mm512_mul_pd(s6, s6), s6);
+    __m512d e = _mm512_mul_pd(_mm512_set1_pd(a->eps4), _mm512_fmsub_pd(s6, s6, s6));
+    __mmask8 positive = _mm512_mask_cmp_pd_mask(mask, r2, _mm512_setzero_pd(), _CMP_GT_OQ);
+    *V = _mm512_mask_add_pd(*V, positive, *V, e);
+
+    __m512d inv_f = _mm512_min_pd(inv, _mm512_set1_pd(a->inv_r2_min));
+    __m512d s6_f = _mm512_mul_pd(_mm512_set1_pd(a->sigma2), inv_f);
+    s6_f = _mm512_mul_pd(_mm512_mul_pd(s6_f, s6_f), s6_f);
+    return _mm512_maskz_mul_pd(mask, _mm512_mul_pd(_mm512_set1_pd(a->eps24), inv_f),
+                               _mm512_fnmadd_pd(_mm512_add_pd(s6_f, s6_f), s6_f, s6_f));
+}
+
+__attribute__((target("avx512f")))
+static double lj_all_avx512(const lj_args_t* a, size_t begin, size_t end, double* W)
+{
+    size_t N = a->Natoms;
+    __m512d V8 = _mm512_setzero_pd(), W8 = _mm512_setzero_pd();
+
+    for (size_t i = begin; i < end; i++)
+    {
+        __m512d xi = _mm512_set1_pd(a->x[i]), yi = _mm512_set1_pd(a->y[i]), zi = _mm512_set1_pd(a->z[i]);
+        __m512d fx = _mm512_setzero_pd(), fy = _mm512_setzero_pd(), fz = _mm512_setzero_pd();
+
+        // The partners j come 8 by 8 from the contiguous arrays, the last ones under a mask
+        for (size_t j = i + 1; j < N; j += 8)
+        {
+            __mmask8 m = (N - j >= 8) ? 0xFF : (__mmask8) ((1u << (N - j)) - 1);
+            __m512d dx = _mm512_sub_pd(xi, _mm512_maskz_loadu_pd(m, a->x + j));
+            __m512d dy = _mm512_sub_pd(yi, _mm512_maskz_loadu_pd(m, a->y + j));
+            __m512d dz = _mm512_sub_pd(zi, _mm512_maskz_loadu_pd(m, a->z + j));
+            __m512d r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+
+            __m512d f = lj_avx512(a, r2, m, &V8);
+            __m512d fdx = _mm512_mul_pd(f, dx), fdy = _mm512_mul_pd(f, dy), fdz = _mm512_mul_pd(f, dz);
+            fx = _mm512_add_pd(fx, fdx);
+            fy = _mm512_add_pd(fy, fdy);
+            fz = _mm512_add_pd(fz, fdz);
+            W8 = _mm512_fnmadd_pd(f, r2, W8);
+
+            __m512d inv_mj = _mm512_maskz_loadu_pd(m, a->inv_mass + j);
+            _mm512_mask_storeu_pd(a->ax + j, m, _mm512_fmadd_pd(fdx, inv_mj, _mm512_maskz_loadu_pd(m, a->ax + j)));
+            _mm512_mask_storeu_pd(a->ay + j, m, _mm512_fmadd_pd(fdy, inv_mj, _mm512_maskz_loadu_pd(m, a->ay + j)));
+            _mm512_mask_storeu_pd(a->az + j, m, _mm512_fmadd_pd(fdz, inv_mj, _mm512_maskz_loadu_pd(m, a->az + j)));
+        }
+
+        double fi[3] = {_mm512_reduce_add_pd(fx), _mm512_reduce_add_pd(fy), _mm512_reduce_add_pd(fz)};
+        lj_apply_scalar(a, i, fi);
+    }
+
+    *W += _mm512_reduce_add_pd(W8);
+    return _mm512_reduce_add_pd(V8);
+}
+
+__attribute__((target("avx512f")))
+static double lj_neighbor_avx512(const lj_args_t* a, const neighbor_list_t* neighbors, size_t begin, size_t end, double* W)
+{
+    __m512d V8 = _mm512_setzero_pd(), W8 = _mm512_setzero_pd();
+    __m512d r2_cut = _mm512_set1_pd(a->r2_cut);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        __m512d xi = _mm512_set1_pd(a->x[i]), yi = _mm512_set1_pd(a->y[i]), zi = _mm512_set1_pd(a->z[i]);
+        __m512d fx = _mm512_setzero_pd(), fy = _mm512_setzero_pd(), fz = _mm512_setzero_pd();
+        size_t last = neighbors->start[i + 1];
+
+        // The partners are gathered 8 by 8 from the list; they are distinct atoms, so that the
+        // scatter of their accelerations has no conflicts
+        for (size_t n = neighbors->start[i]; n < last; n += 8)
+        {
+            __mmask8 m = (last - n >= 8) ? 0xFF : (__mmask8) ((1u << (last - n)) - 1);
+            __m512i j = _mm512_maskz_loadu_epi64(m, neighbors->list + n);
+            __m512d dx = _mm512_sub_pd(xi, _mm512_mask_i64gather_pd(_mm512_setzero_pd(), m, j, a->x, 8));
+            __m512d dy = _mm512_sub_pd(yi, _mm512_mask_i64gather_pd(_mm512_setzero_pd(), m, j, a->y, 8));
+            __m512d dz = _mm512_sub_pd(zi, _mm512_mask_i64gather_pd(_mm512_setzero_pd(), m, j, a->z, 8));
+            __m512d r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+            m = _mm512_mask_cmp_pd_mask(m, r2, r2_cut, _CMP_LT_OQ);
+
+            __m512d f = lj_avx512(a, r2, m, &V8);
+            __m512d fdx = _mm512_mul_pd(f, dx), fdy = _mm512_mul_pd(f, dy), fdz = _mm512_mul_pd(f, dz);
+            fx = _mm512_add_pd(fx, fdx);
+            fy = _mm512_add_pd(fy, fdy);
+            fz = _mm512_add_pd(fz, fdz);
+            W8 = _mm512_fnmadd_pd(f, r2, W8);
+
+            __m512d inv_mj = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), m, j, a->inv_mass, 8);
+            __m512d ajx = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), m, j, a->ax, 8);
+            __m512d ajy = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), m, j, a->ay, 8);
+            __m512d ajz = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), m, j, a->az, 8);
+            _mm512_mask_i64scatter_pd(a->ax, m, j, _mm512_fmadd_pd(fdx, inv_mj, ajx), 8);
+            _mm512_mask_i64scatter_pd(a->ay, m, j, _mm512_fmadd_pd(fdy, inv_mj, ajy), 8);
+            _mm512_mask_i64scatter_pd(a->az, m, j, _mm512_fmadd_pd(fdz, inv_mj, ajz), 8);
+        }
+
+        double fi[3] = {_mm512_reduce_add_pd(fx), _mm512_reduce_add_pd(fy), _mm512_reduce_add_pd(fz)};
+        lj_apply_scalar(a, i, fi);
+    }
+
+    *W += _mm512_reduce_add_pd(W8);
+    return _mm512_reduce_add_pd(V8);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------//
+//                              TO CHOOSE THE KERNEL AT RUN TIME                                //
+// ---------------------------------------------------------------------------------------------//
+
+static const char* lj_kernel_names[LJ_KERNEL_COUNT] = {"scalar", "avx2", "avx512"};
+static int lj_kernel = -1;         // Kernel in use (-1 until the first call chooses one)
+
+int lj_kernel_supported(lj_kernel_t kernel)
+{
+    switch (kernel)
+    {
+        case LJ_KERNEL_SCALAR: return 1;
+#if LJ_HAVE_X86
+        case LJ_KERNEL_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case LJ_KERNEL_AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+        default: return 0;
+    }
+}
+
+int lj_kernel_select(const char* name)
+{
+    if (name == NULL || strcmp(name, "auto") == 0)
+    {
+        lj_kernel = LJ_KERNEL_SCALAR;
+        for (int k = LJ_KERNEL_COUNT - 1; k > LJ_KERNEL_SCALAR; k--)
+        {
+            if (lj_kernel_supported(k))
+            {
+                lj_kernel = k;
+                break;
+            }
+        }
+        return 0;
+    }
+
+    for (int k = 0; k < LJ_KERNEL_COUNT; k++)
+    {
+        if (strcmp(name, lj_kernel_names[k]) == 0)
+        {
+            if (!lj_kernel_supported(k)) return -1;
+            lj_kernel = k;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+lj_kernel_t lj_kernel_current(void)
+{
+    if (lj_kernel < 0) lj_kernel_select(NULL);
+    return lj_kernel;
+}
+
+const char* lj_kernel_name(lj_kernel_t kernel)
+{
+    return (kernel < LJ_KERNEL_COUNT) ? lj_kernel_names[kernel] : "unknown";
+}
+
+// ---------------------------------------------------------------------------------------------//
+//              TO CALCULATE THE ACCELERATIONS, POTENTIAL ENERGY AND VIRIAL                     //
+// ---------------------------------------------------------------------------------------------//
+
+static lj_args_t lj_setup(const particles_t* particles, double* ax, double* ay, double* az, double sigma, double epsilon, double cutoff)
+{
+    lj_args_t a;
+    a.Natoms = particles->Natoms;
+    a.padded = particles->padded;
+    a.x = particles->x;
+    a.y = particles->y;
+    a.z = particles->z;
+    a.inv_mass = particles->inv_mass;
+    a.ax = ax;
+    a.ay = ay;
+    a.az = az;
+    a.sigma2 = sigma * sigma;
+    a.eps4 = 4.0 * epsilon;
+    a.eps24 = 24.0 * epsilon;
+    a.inv_r2_min = 1.0 / (r_min * r_min);
+    a.r2_cut = (cutoff > 0.0) ? cutoff * cutoff : INFINITY;
+
+    // Reset accelerations to zero
+    memset(ax, 0, particles->Natoms * sizeof(double));
+    memset(ay, 0, particles->Natoms * sizeof(double));
+    memset(az, 0, particles->Natoms * sizeof(double));
+    return a;
+}
+
+// The kernel in use on the atoms begin ... end - 1 (all the pairs when neighbors is NULL)
+static double lj_range(lj_kernel_t kernel, const lj_args_t* a, const neighbor_list_t* neighbors, size_t begin, size_t end, double* W)
+{
+    switch (kernel)
+    {
+#if LJ_HAVE_X86
+        case LJ_KERNEL_AVX512:
+            return (neighbors != NULL) ? lj_neighbor_avx512(a, neighbors, begin, end, W) : lj_all_avx512(a, begin, end, W);
+        case LJ_KERNEL_AVX2:
+            return (neighbors != NULL) ? lj_neighbor_avx2(a, neighbors, begin, end, W) : lj_all_avx2(a, begin, end, W);
+#endif
+        default:
+            return (neighbors != NULL) ? lj_neighbor_scalar(a, neighbors, begin, end, W) : lj_all_scalar(a, begin, end, W);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                          TO SHARE THE PAIRS AMONG THE THREADS                                //
+// ---------------------------------------------------------------------------------------------//
+
+// Each thread takes a range of atoms i holding about the same number of pairs (i,j), j > i, and
+// adds the forces of its pairs into its own acceleration arrays, so that the updates of the
+// partners j never race. The arrays are then summed atom by atom, always in the order of the
+// threads, so that a given number of threads always gives the same result.
+
+// Bytes of the thread arrays, and of the ranges and energies that follow them
+static size_t lj_threads_split(int n_threads, size_t padded, size_t* arrays)
+{
+    size_t align = PARTICLES_ALIGN;
+    *arrays = 3 * (size_t) n_threads * padded * sizeof(double);
+    size_t rest = 2 * (size_t) n_threads * sizeof(size_t) + 2 * (size_t) n_threads * sizeof(double);
+    return (rest + align - 1) / align * align;
+}
+
+size_t lj_threads_bytes(int n_threads, size_t padded)
+{
+    if (n_threads <= 1) return 0;
+    size_t arrays;
+    size_t rest = lj_threads_split(n_threads, padded, &arrays);
+    return arrays + rest;
+}
+
+// Only the pages of the atoms a thread writes to are ever touched, so that the buffers are not cleared here
+void lj_threads_attach(lj_threads_t* threads, int n_threads, size_t padded, void* memory)
+{
+    memset(threads, 0, sizeof(lj_threads_t));
+    if (n_threads <= 1) return;
+
+    size_t arrays;
+    lj_threads_split(n_threads, padded, &arrays);
+    threads->n_threads = n_threads;
+    threads->padded = padded;
+    threads->buffer = memory;
+    threads->low = (size_t*) ((char*) memory + arrays);
+    threads->high = threads->low + n_threads;
+    threads->energy = (double*) (threads->high + n_threads);
+}
+
+#ifdef _OPENMP
+
+static lj_threads_t lj_threads_default;    // Buffers of the calls without threads
+
+// The default buffers, grown to the OpenMP threads and the atoms
+static lj_threads_t* lj_threads_reserve(int n_threads, size_t padded)
+{
+    lj_threads_t* threads = &lj_threads_default;
+    if (n_threads <= threads->n_threads && padded <= threads->padded) return threads;
+    lj_forces_free();
+
+    void* memory = aligned_alloc(PARTICLES_ALIGN, lj_threads_bytes(n_threads, padded));
+    if (memory == NULL)
+    {
+        printf("Error: Memory allocation failed for the force buffers of %d threads\n", n_threads);
+        exit(EXIT_FAILURE);
+    }
+    lj_threads_attach(threads, n_threads, padded, memory);
+    return threads;
+}
+
+// Number of pairs (i,j), j > i, of the atoms before atom i
+static size_t lj_pairs_before(const lj_args_t* a, const neighbor_list_t* neighbors, size_t i)
+{
+    if (neighbors != NULL) return neighbors->start[i];
+    return i * (2 * a->Natoms - i - 1) / 2;
+}
+
+// First atom of the share of thread t out of n_threads: the first atom with at least
+// t / n_threads of the pairs before it
+static size_t lj_share(const lj_args_t* a, const neighbor_list_t* neighbors, int t, int n_threads)
+{
+    if (t >= n_threads) return a->Natoms;
+    size_t target = lj_pairs_before(a, neighbors, a->Natoms) * t / n_threads;
+    size_t low = 0, high = a->Natoms;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (lj_pairs_before(a, neighbors, middle) < target) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+static double lj_run_threads(lj_kernel_t kernel, const lj_args_t* a, const neighbor_list_t* neighbors, lj_threads_t* threads,
+                             int n_threads, double* W)
+{
+    size_t N = a->Natoms, padded = threads->padded;
+    double V = 0.0;
+
+    #pragma omp parallel num_threads(n_threads)
+    {
+        int t = omp_get_thread_num(), team = omp_get_num_threads();
+        size_t begin = lj_share(a, neighbors, t, team), end = lj_share(a, neighbors, t + 1, team);
+
+        // The atoms this thread writes to: its own and their partners j > i
+        size_t high = end;
+        if (neighbors == NULL)
+        {
+            if (end > begin) high = N;
+        }
+        else
+        {
+            for (size_t n = neighbors->start[begin]; n < neighbors->start[end]; n++)
+                if (neighbors->list[n] >= high) high = neighbors->list[n] + 1;
+        }
+
+        lj_args_t local = *a;
+        local.ax = threads->buffer + 3 * (size_t) t * padded;
+        local.ay = local.ax + padded;
+        local.az = local.ay + padded;
+        memset(local.ax + begin, 0, (high - begin) * sizeof(double));
+        memset(local.ay + begin, 0, (high - begin) * sizeof(double));
+        memset(local.az + begin, 0, (high - begin) * sizeof(double));
+        threads->low[t] = begin;
+        threads->high[t] = high;
+
+        double W_t = 0.0;
+        threads->energy[2 * t] = lj_range(kernel, &local, neighbors, begin, end, &W_t);
+        threads->energy[2 * t + 1] = W_t;
+
+        // Sum of the accelerations of the threads, in the order of the threads
+        #pragma omp barrier
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < N; i++)
+        {
+            double sx = 0.0, sy = 0.0, sz = 0.0;
+            for (int u = 0; u < team; u++)
+            {
+                if (i < threads->low[u] || i >= threads->high[u]) continue;
+                const double* b = threads->buffer + 3 * (size_t) u * padded;
+                sx += b[i];
+                sy += b[padded + i];
+                sz += b[2 * padded + i];
+            }
+            a->ax[i] = sx;
+            a->ay[i] = sy;
+            a->az[i] = sz;
+        }
+
+        #pragma omp single
+        {
+            for (int u = 0; u < team; u++)
+            {
+                V += threads->energy[2 * u];
+                *W += threads->energy[2 * u + 1];
+            }
+        }
+    }
+
+    return V;
+}
+
+#endif
+
+void lj_forces_free(void)
+{
+#ifdef _OPENMP
+    free(lj_threads_default.buffer);
+    memset(&lj_threads_default, 0, sizeof(lj_threads_t));
+#endif
+}
+
+// The pairs on one thread, or shared among the OpenMP threads (no more than the buffers hold)
+static double lj_run(const lj_args_t* a, lj_threads_t* threads, const neighbor_list_t* neighbors, double* W)
+{
+    lj_kernel_t kernel = lj_kernel_current();
+#ifdef _OPENMP
+    int n_threads = omp_get_max_threads();
+    if (n_threads > 1 && a->Natoms > 1)
+    {
+        if (threads == NULL) threads = lj_threads_reserve(n_threads, a->padded);
+        if (n_threads > threads->n_threads) n_threads = threads->n_threads;
+        if (threads->padded < a->padded) n_threads = 1;
+        if (n_threads > 1) return lj_run_threads(kernel, a, neighbors, threads, n_threads, W);
+    }
+#else
+    (void) threads;
+#endif
+    return lj_range(kernel, a, neighbors, 0, a->Natoms, W);
+}
+
+double compute_forces(const particles_t* particles, lj_threads_t* threads, double* ax, double* ay, double* az,
+                      double sigma, double epsilon, double* virial)
+{
+    lj_args_t a = lj_setup(particles, ax, ay, az, sigma, epsilon, 0.0);
+    double W_total = 0.0;
+    double V_total = lj_run(&a, threads, NULL, &W_total);
+
+    if (virial != NULL) *virial = W_total;
+    return V_total;
+}
+
+double compute_forces_neighbor(const particles_t* particles, lj_threads_t* threads, const neighbor_list_t* neighbors,
+                               double* ax, double* ay, double* az, double sigma, double epsilon, double* virial)
+{
+    lj_args_t a = lj_setup(particles, ax, ay, az, sigma, epsilon, neighbors->cutoff);
+    double W_total = 0.0;
+    double V_total = lj_run(&a, threads, neighbors, &W_total);
+
+    if (virial != NULL) *virial = W_total;
+    return V_total;
+}
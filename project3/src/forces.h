@@ -0,0 +1,67 @@
+#ifndef FORCES_H
+#define FORCES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "particles.h"
+#include "neighbor.h"
+
+// Implementations of the Lennard-Jones kernels, from the narrowest to the widest vectors
+typedef enum
+{
+    LJ_KERNEL_SCALAR = 0,   // Portable C, one pair at a time
+    LJ_KERNEL_AVX2,         // 4 pairs at a time (AVX2 and FMA)
+    LJ_KERNEL_AVX512,       // 8 pairs at a time (AVX-512F)
+    LJ_KERNEL_COUNT
+} lj_kernel_t;
+
+// Buffers of the threads of the force functions, reused from one call to the next: the
+// accelerations each thread adds its pairs into, before they are summed (OpenMP builds only)
+typedef struct
+{
+    int n_threads;          // Number of threads the buffers are laid out for
+    size_t padded;          // Length of each array
+    double* buffer;         // Accelerations of each thread (3 arrays per thread)
+    size_t* low;            // First atom each thread wrote to
+    size_t* high;           // One past the last atom each thread wrote to
+    double* energy;         // Potential energy and virial of each thread
+} lj_threads_t;
+
+// Function to return the number of bytes of the buffers of n_threads threads for arrays of padded
+// doubles (a multiple of PARTICLES_ALIGN, zero for a single thread)
+size_t lj_threads_bytes(int n_threads, size_t padded);
+
+// Function to lay out the buffers in memory of lj_threads_bytes(n_threads, padded) bytes aligned
+// on PARTICLES_ALIGN, that the caller keeps owning
+void lj_threads_attach(lj_threads_t* threads, int n_threads, size_t padded, void* memory);
+
+// Function to tell whether the processor can run a kernel
+int lj_kernel_supported(lj_kernel_t kernel);
+
+// Function to choose the kernel of the force functions: "auto" (or NULL) for the widest one the
+// processor supports, otherwise "scalar", "avx2" or "avx512". Returns -1 for an unknown name or a
+// kernel the processor cannot run, leaving the current one in place.
+int lj_kernel_select(const char* name);
+
+// Function to return the kernel in use
+lj_kernel_t lj_kernel_current(void);
+
+// Function to return the name of a kernel
+const char* lj_kernel_name(lj_kernel_t kernel);
+
+// Function to compute the accelerations ax, ay, az of the atoms from all the pairs, returning the
+// potential energy (and the virial, if not NULL), in one pass over the pairs of atoms.
+// Built with OpenMP, the pairs are shared among at most threads->n_threads threads (or among the
+// OpenMP threads, in buffers kept by the force functions, when threads is NULL); the result then
+// depends only on the number of threads.
+double compute_forces(const particles_t* particles, lj_threads_t* threads, double* ax, double* ay, double* az,
+                      double sigma, double epsilon, double* virial);
+
+// Function to compute the accelerations, potential energy and virial from the pairs of the neighbor list closer than the cutoff
+double compute_forces_neighbor(const particles_t* particles, lj_threads_t* threads, const neighbor_list_t* neighbors,
+                               double* ax, double* ay, double* az, double sigma, double epsilon, double* virial);
+
+// Function to free the buffers kept by the force functions for the calls without threads
+void lj_forces_free(void);
+
+#endif
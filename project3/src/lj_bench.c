@@ -0,0 +1,189 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<math.h>
+#include<time.h>
+#ifdef _OPENMP
+#include<omp.h>
+#endif
+#include "utils.h"
+#include "error.h"
+#include "neighbor.h"
+#include "forces.h"
+
+// --------------------------------------------------------------------------------------------- //
+// ****************************** MICRO-BENCHMARK OF THE FORCE KERNELS ************************* //
+// --------------------------------------------------------------------------------------------- //
+
+// Usage: ./lj_bench [Natoms] [repeats] [cutoff]
+// Times the force kernels on a slightly disordered cubic lattice of argon atoms and reports the
+// pairs per second: first the kernel with pow on the N x 3 arrays that the structure of arrays
+// replaced, then every kernel the processor supports, on all the pairs and on the neighbor list.
+// The deviation of each kernel from the scalar one is printed alongside. Built with OpenMP
+// (make omp), the kernels run on OMP_NUM_THREADS threads and the pow kernel on one.
+
+const double epsilon = 0.0661;    // Lennard-Jones epsilon in J/mol
+const double sigma   = 0.3345;    // Lennard-Jones sigma in nm
+const double spacing = 0.38;      // Lattice spacing in nm
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+// The previous kernel: N x 3 arrays, pow and divisions by r and by the masses in every pair
+static double reference_forces(size_t Natoms, double** coord, double* mass, double** acceleration)
+{
+    double r_min = 0.1;
+    double V_total = 0.0;
+
+    for (size_t i = 0; i < Natoms; i++)
+        for (size_t k = 0; k < 3; k++)
+            acceleration[i][k] = 0.0;
+
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        for (size_t j = i + 1; j < Natoms; j++)
+        {
+            double dx = coord[i][0] - coord[j][0];
+            double dy = coord[i][1] - coord[j][1];
+            double dz = coord[i][2] - coord[j][2];
+            double r = sqrt(dx * dx + dy * dy + dz * dz);
+            if (r > 0)
+            {
+                double t6 = pow(sigma / r, 6);
+                V_total += 4 * epsilon * (t6 * t6 - t6);
+            }
+            if (r < r_min) r = r_min;
+            double t6 = pow(sigma / r, 6);
+            double force = (24.0 * epsilon / r) * (t6 - 2.0 * t6 * t6);
+            double f[3] = {force * dx / r, force * dy / r, force * dz / r};
+            for (size_t k = 0; k < 3; k++)
+            {
+                acceleration[i][k] += (-1.0 / mass[i]) * f[k];
+                acceleration[j][k] += (1.0 / mass[j]) * f[k];
+            }
+        }
+    }
+    return V_total;
+}
+
+// Largest deviation of the forces a from the forces b
+static double largest_deviation(const particles_t* particles, double* a[3], double* b[3])
+{
+    double deviation = 0.0;
+    for (size_t k = 0; k < 3; k++)
+        for (size_t i = 0; i < particles->Natoms; i++)
+            if (particles->mass[i] * fabs(a[k][i] - b[k][i]) > deviation) deviation = particles->mass[i] * fabs(a[k][i] - b[k][i]);
+    return deviation;
+}
+
+int main(int argc, char** argv)
+{
+    size_t Natoms = (argc > 1) ? (size_t) atol(argv[1]) : 4000;
+    int repeats = (argc > 2) ? atoi(argv[2]) : 10;
+    double cutoff = (argc > 3) ? atof(argv[3]) : 0.85;
+    if (Natoms < 2 || repeats < 1 || cutoff <= 0.0)
+    {
+        printf("Usage: %s [Natoms >= 2] [repeats >= 1] [cutoff > 0]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Cubic lattice, each atom moved by up to 5% of the spacing
+    particles_t* particles = particles_create(Natoms);
+    size_t side = 1;
+    while (side * side * side < Natoms) side++;
+    srand(12345);
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        particles->x[i] = spacing * (i % side + 0.05 * (2.0 * rand() / RAND_MAX - 1.0));
+        particles->y[i] = spacing * ((i / side) % side + 0.05 * (2.0 * rand() / RAND_MAX - 1.0));
+        particles->z[i] = spacing * (i / (side * side) + 0.05 * (2.0 * rand() / RAND_MAX - 1.0));
+        particles->mass[i] = 39.948;
+    }
+    particles_set_inverse_mass(particles);
+
+    neighbor_list_t* neighbors = neighbor_list_create(Natoms, cutoff, 0.0);
+    neighbor_list_build(neighbors, particles);
+
+    double all_pairs = 0.5 * (double) Natoms * (Natoms - 1);
+    double list_pairs = (double) neighbors->start[Natoms];
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    printf("%zu atoms, %d repeats, %d thread(s): %.0f pairs in all, %.0f in the list of cutoff %.3f\n\n", Natoms, repeats, n_threads,
+           all_pairs, list_pairs, cutoff);
+    printf("%-10s %-10s %12s %14s %14s %14s\n", "kernel", "pairs", "time (s)", "pairs/s", "force dev.", "energy dev.");
+
+    // The pow kernel on the N x 3 arrays
+    double** coord = malloc_2d(Natoms, 3);
+    double** acceleration = malloc_2d(Natoms, 3);
+    if (coord == NULL || acceleration == NULL) error_memory_allocation("reference arrays");
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        coord[i][0] = particles->x[i];
+        coord[i][1] = particles->y[i];
+        coord[i][2] = particles->z[i];
+    }
+    double start = seconds();
+    for (int r = 0; r < repeats; r++) reference_forces(Natoms, coord, particles->mass, acceleration);
+    double time = seconds() - start;
+    printf("%-10s %-10s %12.4f %14.3e\n", "pow", "all", time, repeats * all_pairs / time);
+    double reference_rate = repeats * all_pairs / time;
+
+    // Forces of the scalar kernel, that the other kernels are compared with
+    double* ref[2][3];
+    double* acc[3];
+    double V_ref[2];
+    for (size_t k = 0; k < 3; k++)
+    {
+        ref[0][k] = particles_array(particles);
+        ref[1][k] = particles_array(particles);
+        acc[k] = particles_array(particles);
+    }
+    lj_kernel_select("scalar");
+    V_ref[0] = compute_forces(particles, NULL, ref[0][0], ref[0][1], ref[0][2], sigma, epsilon, NULL);
+    V_ref[1] = compute_forces_neighbor(particles, NULL, neighbors, ref[1][0], ref[1][1], ref[1][2], sigma, epsilon, NULL);
+
+    for (int kernel = 0; kernel < LJ_KERNEL_COUNT; kernel++)
+    {
+        if (lj_kernel_select(lj_kernel_name(kernel)) != 0)
+        {
+            printf("%-10s (not supported by this processor)\n", lj_kernel_name(kernel));
+            continue;
+        }
+
+        for (int list = 0; list < 2; list++)
+        {
+            double V = 0.0;
+            start = seconds();
+            for (int r = 0; r < repeats; r++)
+            {
+                V = list ? compute_forces_neighbor(particles, NULL, neighbors, acc[0], acc[1], acc[2], sigma, epsilon, NULL)
+                         : compute_forces(particles, NULL, acc[0], acc[1], acc[2], sigma, epsilon, NULL);
+            }
+            time = seconds() - start;
+            double pairs = list ? list_pairs : all_pairs;
+            printf("%-10s %-10s %12.4f %14.3e %14.3e %14.3e", lj_kernel_name(kernel), list ? "list" : "all", time,
+                   repeats * pairs / time, largest_deviation(particles, acc, ref[list]), fabs(V - V_ref[list]));
+            if (!list) printf("   (x%.1f)", repeats * pairs / time / reference_rate);
+            printf("\n");
+        }
+    }
+
+    for (size_t k = 0; k < 3; k++)
+    {
+        free(ref[0][k]);
+        free(ref[1][k]);
+        free(acc[k]);
+    }
+    free_2d(coord);
+    free_2d(acceleration);
+    neighbor_list_free(neighbors);
+    particles_free(particles);
+    lj_forces_free();
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "error.h"
+#include "neighbor.h"
+
+// ---------------------------------------------------------------------------------------------//
+//                      TO ALLOCATE AND FREE THE NEIGHBOR LIST                                  //
+// ---------------------------------------------------------------------------------------------//
+
+neighbor_list_t* neighbor_list_create(size_t Natoms, double cutoff, double skin)
+{
+    neighbor_list_t* neighbors = calloc(1, sizeof(neighbor_list_t));
+    if (neighbors == NULL) error_memory_allocation("neighbor list");
+
+    neighbors->Natoms = Natoms;
+    neighbors->cutoff = cutoff;
+    neighbors->skin = skin;
+
+    // A few tens of neighbors per atom to start with, the list grows when needed
+    neighbors->capacity = 32 * Natoms + 1;
+    neighbors->start = malloc((Natoms + 1) * sizeof(size_t));
+    neighbors->list = malloc(neighbors->capacity * sizeof(size_t));
+    neighbors->ref_coord = malloc_2d(Natoms, 3);
+    neighbors->cell_next = malloc(Natoms * sizeof(size_t));
+    neighbors->cell_of = malloc(Natoms * sizeof(size_t));
+    if (neighbors->start == NULL || neighbors->list == NULL || neighbors->ref_coord == NULL ||
+        neighbors->cell_next == NULL || neighbors->cell_of == NULL)
+        error_memory_allocation("neighbor list");
+
+    return neighbors;
+}
+
+void neighbor_list_free(neighbor_list_t* neighbors)
+{
+    if (neighbors == NULL) return;
+    free(neighbors->start);
+    free(neighbors->list);
+    free_2d(neighbors->ref_coord);
+    free(neighbors->cell_head);
+    free(neighbors->cell_next);
+    free(neighbors->cell_of);
+    free(neighbors);
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                              TO SORT THE ATOMS INTO CELLS                                    //
+// ---------------------------------------------------------------------------------------------//
+
+// The cells tile the box around the atoms, with edges of at least cutoff + skin so that every
+// pair of the list lies in the same or in adjacent cells. The molecule is not periodic: the
+// box just follows the atoms. A sparse system gets larger cells rather than mostly empty ones.
+static void neighbor_sort_cells(neighbor_list_t* neighbors, const particles_t* particles, size_t n_cells[3])
+{
+    size_t Natoms = neighbors->Natoms;
+    const double* coord[3] = {particles->x, particles->y, particles->z};
+    double low[3], high[3];
+
+    for (size_t k = 0; k < 3; k++)
+    {
+        low[k] = coord[k][0];
+        high[k] = coord[k][0];
+    }
+    for (size_t i = 1; i < Natoms; i++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            if (coord[k][i] < low[k]) low[k] = coord[k][i];
+            if (coord[k][i] > high[k]) high[k] = coord[k][i];
+        }
+    }
+
+    double edge = neighbors->cutoff + neighbors->skin;
+    size_t total;
+    while (1)
+    {
+        for (size_t k = 0; k < 3; k++) n_cells[k] = (size_t) ((high[k] - low[k]) / edge) + 1;
+        total = n_cells[0] * n_cells[1] * n_cells[2];
+        if (total <= 2 * Natoms + 27) break;
+        edge *= 1.5;
+    }
+
+    if (total > neighbors->n_cells_max)
+    {
+        free(neighbors->cell_head);
+        neighbors->cell_head = malloc(total * sizeof(size_t));
+        if (neighbors->cell_head == NULL) error_memory_allocation("neighbor cells");
+        neighbors->n_cells_max = total;
+    }
+
+    // Linked list of the atoms of each cell
+    for (size_t c = 0; c < total; c++) neighbors->cell_head[c] = Natoms;
+    for (size_t i = Natoms; i-- > 0; )
+    {
+        size_t cell[3];
+        for (size_t k = 0; k < 3; k++)
+        {
+            cell[k] = (size_t) ((coord[k][i] - low[k]) / edge);
+            if (cell[k] >= n_cells[k]) cell[k] = n_cells[k] - 1;
+        }
+        size_t c = (cell[2] * n_cells[1] + cell[1]) * n_cells[0] + cell[0];
+        neighbors->cell_of[i] = c;
+        neighbors->cell_next[i] = neighbors->cell_head[c];
+        neighbors->cell_head[c] = i;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                              TO BUILD THE NEIGHBOR LIST                                      //
+// ---------------------------------------------------------------------------------------------//
+
+void neighbor_list_build(neighbor_list_t* neighbors, const particles_t* particles)
+{
+    const double* coord[3] = {particles->x, particles->y, particles->z};
+    size_t Natoms = neighbors->Natoms;
+    double r_list = neighbors->cutoff + neighbors->skin;
+    double r2_list = r_list * r_list;
+    size_t n_cells[3];
+    size_t count = 0;
+
+    neighbor_sort_cells(neighbors, particles, n_cells);
+
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        neighbors->start[i] = count;
+
+        size_t c = neighbors->cell_of[i];
+        long cx = c % n_cells[0];
+        long cy = (c / n_cells[0]) % n_cells[1];
+        long cz = c / (n_cells[0] * n_cells[1]);
+
+        // The cell of atom i and its 26 neighbors
+        for (long z = cz - 1; z <= cz + 1; z++)
+        {
+            if (z < 0 || z >= (long) n_cells[2]) continue;
+            for (long y = cy - 1; y <= cy + 1; y++)
+            {
+                if (y < 0 || y >= (long) n_cells[1]) continue;
+                for (long x = cx - 1; x <= cx + 1; x++)
+                {
+                    if (x < 0 || x >= (long) n_cells[0]) continue;
+
+                    size_t other = ((size_t) z * n_cells[1] + y) * n_cells[0] + x;
+                    for (size_t j = neighbors->cell_head[other]; j < Natoms; j = neighbors->cell_next[j])
+                    {
+                        if (j <= i) continue;   // Each pair once
+
+                        double dx = coord[0][i] - coord[0][j];
+                        double dy = coord[1][i] - coord[1][j];
+                        double dz = coord[2][i] - coord[2][j];
+                        if (dx * dx + dy * dy + dz * dz >= r2_list) continue;
+
+                        if (count == neighbors->capacity)
+                        {
+                            size_t* list = realloc(neighbors->list, 2 * neighbors->capacity * sizeof(size_t));
+                            if (list == NULL) error_memory_allocation("neighbor list");
+                            neighbors->list = list;
+                            neighbors->capacity *= 2;
+                        }
+                        neighbors->list[count++] = j;
+                    }
+                }
+            }
+        }
+    }
+    neighbors->start[Natoms] = count;
+
+    // Positions the displacements are measured from
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        neighbors->ref_coord[i][0] = coord[0][i];
+        neighbors->ref_coord[i][1] = coord[1][i];
+        neighbors->ref_coord[i][2] = coord[2][i];
+    }
+
+    neighbors->n_builds++;
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                      TO REBUILD THE LIST WHEN THE ATOMS MOVED TOO FAR                        //
+// ---------------------------------------------------------------------------------------------//
+
+// Two atoms that both moved by less than skin/2 came closer by less than skin, so every pair
+// now within the cutoff was within cutoff + skin at the last build and is still in the list.
+int neighbor_list_update(neighbor_list_t* neighbors, const particles_t* particles)
+{
+    double limit = 0.25 * neighbors->skin * neighbors->skin;
+
+    for (size_t i = 0; i < neighbors->Natoms; i++)
+    {
+        double dx = particles->x[i] - neighbors->ref_coord[i][0];
+        double dy = particles->y[i] - neighbors->ref_coord[i][1];
+        double dz = particles->z[i] - neighbors->ref_coord[i][2];
+        if (dx * dx + dy * dy + dz * dz > limit)
+        {
+            neighbor_list_build(neighbors, particles);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef NEIGHBOR_H
+#define NEIGHBOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "particles.h"
+
+// Verlet neighbor list of the pairs closer than cutoff + skin, built from linked cells.
+// Only the pairs (i,j) with j > i are kept: the neighbors of atom i are
+// list[start[i]] ... list[start[i+1] - 1]. The list stays valid as long as no atom moved
+// by more than skin/2 since it was built, so it is only rebuilt when one did.
+typedef struct
+{
+    size_t Natoms;          // Number of atoms
+    double cutoff;          // Distance beyond which the pairs do not interact
+    double skin;            // Extra distance kept in the list, so that it outlives a few steps
+    size_t* start;          // First neighbor of each atom in list (Natoms + 1)
+    size_t* list;           // Neighbors j > i of each atom, one atom after the other
+    size_t capacity;        // Number of entries allocated in list
+    double** ref_coord;     // Coordinates of the atoms when the list was built (Natoms x 3)
+    size_t* cell_head;      // First atom of each cell (Natoms for an empty cell)
+    size_t* cell_next;      // Next atom of the same cell (Natoms at the end)
+    size_t* cell_of;        // Cell of each atom
+    size_t n_cells_max;     // Number of cells allocated in cell_head
+    size_t n_builds;        // Number of times the list was built
+} neighbor_list_t;
+
+// Function to allocate a neighbor list for Natoms atoms
+neighbor_list_t* neighbor_list_create(size_t Natoms, double cutoff, double skin);
+
+// Function to free a neighbor list
+void neighbor_list_free(neighbor_list_t* neighbors);
+
+// Function to build the neighbor list from linked cells
+void neighbor_list_build(neighbor_list_t* neighbors, const particles_t* particles);
+
+// Function to rebuild the neighbor list when an atom moved by more than skin/2 (returns 1 if it was rebuilt)
+int neighbor_list_update(neighbor_list_t* neighbors, const particles_t* particles);
+
+#endif
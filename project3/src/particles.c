@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "particles.h"
+
+// ---------------------------------------------------------------------------------------------//
+//                      TO ALLOCATE AND FREE THE ARRAYS OF THE ATOMS                            //
+// ---------------------------------------------------------------------------------------------//
+
+double* particles_array(const particles_t* particles)
+{
+    double* a = aligned_alloc(PARTICLES_ALIGN, particles->padded * sizeof(double));
+    if (a == NULL) error_memory_allocation("particles");
+    memset(a, 0, particles->padded * sizeof(double));
+    return a;
+}
+
+size_t particles_padded(size_t Natoms)
+{
+    size_t per_vector = PARTICLES_ALIGN / sizeof(double);
+    size_t padded = (Natoms + per_vector - 1) / per_vector * per_vector;
+    return (padded == 0) ? per_vector : padded;
+}
+
+size_t particles_bytes(size_t Natoms)
+{
+    return 11 * particles_padded(Natoms) * sizeof(double);
+}
+
+void particles_attach(particles_t* particles, size_t Natoms, void* memory)
+{
+    size_t padded = particles_padded(Natoms);
+    double* a = memory;
+    memset(a, 0, particles_bytes(Natoms));
+
+    particles->Natoms = Natoms;
+    particles->padded = padded;
+    particles->x = a;
+    particles->y = a + padded;
+    particles->z = a + 2 * padded;
+    particles->vx = a + 3 * padded;
+    particles->vy = a + 4 * padded;
+    particles->vz = a + 5 * padded;
+    particles->ax = a + 6 * padded;
+    particles->ay = a + 7 * padded;
+    particles->az = a + 8 * padded;
+    particles->mass = a + 9 * padded;
+    particles->inv_mass = a + 10 * padded;
+    particles->block = NULL;
+}
+
+particles_t* particles_create(size_t Natoms)
+{
+    particles_t* particles = calloc(1, sizeof(particles_t));
+    if (particles == NULL) error_memory_allocation("particles");
+
+    // Each array is a whole number of vectors, so that all of them stay aligned
+    void* block = aligned_alloc(PARTICLES_ALIGN, particles_bytes(Natoms));
+    if (block == NULL) error_memory_allocation("particles");
+    particles_attach(particles, Natoms, block);
+    particles->block = block;
+
+    return particles;
+}
+
+void particles_free(particles_t* particles)
+{
+    if (particles == NULL) return;
+    free(particles->block);
+    free(particles);
+}
+
+void particles_set_inverse_mass(particles_t* particles)
+{
+    for (size_t i = 0; i < particles->Natoms; i++)
+        particles->inv_mass[i] = 1.0 / particles->mass[i];
+}
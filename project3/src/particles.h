@@ -0,0 +1,53 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Alignment of the arrays in bytes (one AVX-512 vector, one cache line)
+#define PARTICLES_ALIGN 64
+
+// Structure of arrays of the atoms: each component is a separate array, aligned on
+// PARTICLES_ALIGN and padded to a whole number of vectors, so that the force kernels load
+// the coordinates of consecutive atoms as one vector. The padding is zero and never read as atoms.
+typedef struct
+{
+    size_t Natoms;          // Number of atoms
+    size_t padded;          // Length of each array (Natoms rounded up to a whole vector)
+    double* x;              // Coordinates
+    double* y;
+    double* z;
+    double* vx;             // Velocities
+    double* vy;
+    double* vz;
+    double* ax;             // Accelerations
+    double* ay;
+    double* az;
+    double* mass;           // Masses
+    double* inv_mass;       // Inverse masses, so that the kernels multiply instead of divide
+    void* block;            // Memory of the arrays, when they own it (NULL inside an arena)
+} particles_t;
+
+// Function to return the length of each array of Natoms atoms: Natoms rounded up to a whole vector
+size_t particles_padded(size_t Natoms);
+
+// Function to return the number of bytes of the arrays of Natoms atoms (a multiple of PARTICLES_ALIGN)
+size_t particles_bytes(size_t Natoms);
+
+// Function to lay out the arrays of Natoms atoms in memory of particles_bytes(Natoms) bytes aligned
+// on PARTICLES_ALIGN, that the caller keeps owning, and set them to zero
+void particles_attach(particles_t* particles, size_t Natoms, void* memory);
+
+// Function to allocate the arrays of Natoms atoms in one block, all set to zero
+particles_t* particles_create(size_t Natoms);
+
+// Function to free the particles
+void particles_free(particles_t* particles);
+
+// Function to allocate one zeroed array of the length of the particle arrays
+double* particles_array(const particles_t* particles);
+
+// Function to compute the inverse masses once the masses are read
+void particles_set_inverse_mass(particles_t* particles);
+
+#endif
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "error.h"
+#include "simulation.h"
+
+// ---------------------------------------------------------------------------------------------//
+//                          TO ALLOCATE AND FREE THE CONTEXT                                    //
+// ---------------------------------------------------------------------------------------------//
+
+// Lays the arrays of the context out from base, or only counts their bytes when base is NULL.
+// Every piece is a multiple of PARTICLES_ALIGN bytes, so that all of them stay aligned.
+static size_t md_context_layout(md_context_t* context, char* base, int check, int n_threads)
+{
+    size_t used = 0;
+    size_t Natoms = context->Natoms;
+
+    if (base != NULL) particles_attach(&context->particles, Natoms, base);
+    used += particles_bytes(Natoms);
+
+    // The accelerations of the next step and of the check, padded as the particle arrays
+    size_t padded = particles_padded(Natoms);
+    size_t array = padded * sizeof(double);
+    double** arrays[6] = {&context->next_ax, &context->next_ay, &context->next_az,
+                          &context->check_ax, &context->check_ay, &context->check_az};
+    for (int k = 0; k < (check ? 6 : 3); k++)
+    {
+        if (base != NULL)
+        {
+            *arrays[k] = (double*) (base + used);
+            memset(base + used, 0, array);
+        }
+        used += array;
+    }
+
+    if (base != NULL) lj_threads_attach(&context->threads, n_threads, padded, base + used);
+    used += lj_threads_bytes(n_threads, padded);
+
+    return used;
+}
+
+md_context_t* md_context_create(size_t Natoms, double dt, double sigma, double epsilon, double cutoff, double skin, int check)
+{
+    md_context_t* context = calloc(1, sizeof(md_context_t));
+    if (context == NULL) error_memory_allocation("simulation context");
+
+    context->Natoms = Natoms;
+    context->dt = dt;
+    context->sigma = sigma;
+    context->epsilon = epsilon;
+
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+
+    // One block for all the arrays
+    context->arena_bytes = md_context_layout(context, NULL, check, n_threads);
+    context->arena = aligned_alloc(PARTICLES_ALIGN, context->arena_bytes);
+    if (context->arena == NULL) error_memory_allocation("simulation arena");
+    md_context_layout(context, context->arena, check, n_threads);
+
+    if (cutoff > 0.0) context->neighbors = neighbor_list_create(Natoms, cutoff, skin);
+
+    return context;
+}
+
+void md_context_free(md_context_t* context)
+{
+    if (context == NULL) return;
+    neighbor_list_free(context->neighbors);
+    free(context->arena);
+    free(context);
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                          TO COMPUTE THE FORCES OF THE CONTEXT                                //
+// ---------------------------------------------------------------------------------------------//
+
+// Forces at the current positions into ax, ay, az (the neighbor list is brought up to date first)
+static double md_context_forces(md_context_t* context, double* ax, double* ay, double* az)
+{
+    particles_t* particles = &context->particles;
+
+    if (context->neighbors != NULL)
+    {
+        neighbor_list_update(context->neighbors, particles);
+        return compute_forces_neighbor(particles, &context->threads, context->neighbors, ax, ay, az,
+                                       context->sigma, context->epsilon, &context->virial);
+    }
+    return compute_forces(particles, &context->threads, ax, ay, az, context->sigma, context->epsilon, &context->virial);
+}
+
+double md_context_start(md_context_t* context)
+{
+    particles_t* particles = &context->particles;
+
+    particles_set_inverse_mass(particles);
+    if (context->neighbors != NULL) neighbor_list_build(context->neighbors, particles);
+    context->potential = md_context_forces(context, particles->ax, particles->ay, particles->az);
+    context->step = 0;
+    return context->potential;
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                                  VERLET AlGORITHM                                            //
+// ---------------------------------------------------------------------------------------------//
+
+// With a neighbor list, the list is rebuilt when the atoms moved too far and only its pairs
+// closer than the cutoff interact. Returns the potential energy at the new positions.
+double verlet_update(md_context_t* context)
+{
+    particles_t* particles = &context->particles;
+    size_t Natoms = context->Natoms;
+    double dt = context->dt;
+    double* x = particles->x;
+    double* y = particles->y;
+    double* z = particles->z;
+    double* vx = particles->vx;
+    double* vy = particles->vy;
+    double* vz = particles->vz;
+    double* ax = particles->ax;
+    double* ay = particles->ay;
+    double* az = particles->az;
+    double* new_ax = context->next_ax;
+    double* new_ay = context->next_ay;
+    double* new_az = context->next_az;
+
+    // Updating the positions of the atoms
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        x[i] += vx[i] * dt + 0.5 * ax[i] * dt * dt;
+        y[i] += vy[i] * dt + 0.5 * ay[i] * dt * dt;
+        z[i] += vz[i] * dt + 0.5 * az[i] * dt * dt;
+    }
+
+    // Computing  accelerations
+    context->potential = md_context_forces(context, new_ax, new_ay, new_az);
+
+    // Updating the velocity vectors
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        vx[i] += 0.5 * (ax[i] + new_ax[i]) * dt;
+        vy[i] += 0.5 * (ay[i] + new_ay[i]) * dt;
+        vz[i] += 0.5 * (az[i] + new_az[i]) * dt;
+    }
+
+    // The new accelerations become the current ones, and the old arrays receive those of the next step
+    particles->ax = new_ax;
+    particles->ay = new_ay;
+    particles->az = new_az;
+    context->next_ax = ax;
+    context->next_ay = ay;
+    context->next_az = az;
+
+    context->step++;
+    return context->potential;
+}
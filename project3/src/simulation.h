@@ -0,0 +1,51 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "particles.h"
+#include "neighbor.h"
+#include "forces.h"
+
+// State of one simulation: the atoms, the buffers of the steps and the neighbor list, allocated
+// once by md_context_create and reused at every step. The arrays live in one arena aligned on
+// PARTICLES_ALIGN, and a step swaps the pointers of the old and new accelerations instead of
+// copying them, so that it allocates nothing.
+typedef struct
+{
+    size_t Natoms;              // Number of atoms
+    double dt;                  // Time step
+    double sigma;               // Lennard-Jones sigma
+    double epsilon;             // Lennard-Jones epsilon
+    particles_t particles;      // Coordinates, velocities, accelerations and masses
+    double* next_ax;            // Accelerations at the new positions of a step, swapped with those of particles
+    double* next_ay;
+    double* next_az;
+    double* check_ax;           // Accelerations of all the pairs, for the checks (NULL unless asked for)
+    double* check_ay;
+    double* check_az;
+    lj_threads_t threads;       // Buffers of the force threads
+    neighbor_list_t* neighbors; // Neighbor list of the cutoff (NULL: all the pairs interact)
+    double potential;           // Potential energy at the current positions
+    double virial;              // Virial at the current positions
+    size_t step;                // Number of steps done
+    void* arena;                // Memory of all the arrays above
+    size_t arena_bytes;         // Size of the arena
+} md_context_t;
+
+// Function to create the context of Natoms atoms, all set to zero. With cutoff > 0 the forces
+// come from a neighbor list of the given skin; with check the arrays of the all-pairs check are
+// allocated as well. The force buffers are laid out for the OpenMP threads of the time of the call.
+md_context_t* md_context_create(size_t Natoms, double dt, double sigma, double epsilon, double cutoff, double skin, int check);
+
+// Function to free a context
+void md_context_free(md_context_t* context);
+
+// Function to start the simulation once the coordinates, velocities and masses of the particles
+// are set: inverse masses, neighbor list, and the forces at the current positions. Returns the potential energy.
+double md_context_start(md_context_t* context);
+
+// The verlet algorithm: one step of the context, returning the potential energy at the new positions
+double verlet_update(md_context_t* context);
+
+#endif
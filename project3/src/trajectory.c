@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "error.h"
+#include "trajectory.h"
+
+static const char trajectory_magic[8] = {'M', 'D', 'T', 'R', 'J', '0', '1', '\n'};
+static const char trajectory_index_magic[8] = {'M', 'D', 'T', 'R', 'J', 'I', 'D', 'X'};
+
+// Bytes before the payload of a frame: size, kind, step and the three energies
+#define TRAJECTORY_FRAME_HEAD (2 * sizeof(uint32_t) + sizeof(uint64_t) + 3 * sizeof(double))
+
+// Bytes of the largest payload: 3 Natoms doubles, or 3 Natoms varints of up to 10 bytes
+#define TRAJECTORY_MAX_PAYLOAD(Natoms) (30 * (size_t) (Natoms))
+
+// ---------------------------------------------------------------------------------------------//
+//                          TO ENCODE AND DECODE THE COORDINATES                                //
+// ---------------------------------------------------------------------------------------------//
+
+// Signed to unsigned, small magnitudes first: 0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static int64_t unzigzag(uint64_t u)
+{
+    return (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+}
+
+// Seven bits per byte, the high bit set on all the bytes but the last
+static size_t put_varint(unsigned char* p, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        p[n++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char) v;
+    return n;
+}
+
+// Returns the number of bytes read, 0 if the varint runs past end
+static size_t get_varint(const unsigned char* p, const unsigned char* end, uint64_t* v)
+{
+    uint64_t value = 0;
+    for (size_t n = 0; n < 10 && p + n < end; n++)
+    {
+        value |= (uint64_t) (p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80))
+        {
+            *v = value;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                              TO WRITE A BINARY TRAJECTORY                                    //
+// ---------------------------------------------------------------------------------------------//
+
+trajectory_writer_t* trajectory_open_write(const char* filename, size_t Natoms, char** symbols, double precision)
+{
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) return NULL;
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    trajectory_writer_t* writer = calloc(1, sizeof(trajectory_writer_t));
+    if (writer == NULL) error_memory_allocation("trajectory writer");
+    writer->file = file;
+    writer->Natoms = Natoms;
+    writer->precision = (precision > 0.0) ? precision : 0.0;
+    writer->capacity = 1024;
+    writer->offsets = malloc(writer->capacity * sizeof(uint64_t));
+    writer->previous = calloc(3 * Natoms, sizeof(int64_t));
+    writer->before = calloc(3 * Natoms, sizeof(int64_t));
+    writer->buffer = malloc(TRAJECTORY_FRAME_HEAD + TRAJECTORY_MAX_PAYLOAD(Natoms));
+    if (writer->offsets == NULL || writer->previous == NULL || writer->before == NULL || writer->buffer == NULL)
+        error_memory_allocation("trajectory writer");
+
+    uint64_t n = Natoms, interval = TRAJECTORY_KEY_INTERVAL;
+    fwrite(trajectory_magic, 1, sizeof(trajectory_magic), file);
+    fwrite(&n, sizeof(n), 1, file);
+    fwrite(&writer->precision, sizeof(double), 1, file);
+    fwrite(&interval, sizeof(interval), 1, file);
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        char symbol[TRAJECTORY_SYMBOL] = {0};
+        strncpy(symbol, symbols[i], TRAJECTORY_SYMBOL - 1);
+        fwrite(symbol, 1, TRAJECTORY_SYMBOL, file);
+    }
+    writer->position = sizeof(trajectory_magic) + 3 * sizeof(uint64_t) + Natoms * TRAJECTORY_SYMBOL;
+
+    if (ferror(file))
+    {
+        trajectory_close_write(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int trajectory_write_frame(trajectory_writer_t* writer, const particles_t* particles, const trajectory_frame_t* frame)
+{
+    size_t N = writer->Natoms;
+    const double* coord[3] = {particles->x, particles->y, particles->z};
+    unsigned char* payload = writer->buffer + TRAJECTORY_FRAME_HEAD;
+    size_t size = 0;
+    uint32_t kind;
+
+    if (writer->n_frames == writer->capacity)
+    {
+        uint64_t* offsets = realloc(writer->offsets, 2 * writer->capacity * sizeof(uint64_t));
+        if (offsets == NULL) error_memory_allocation("trajectory index");
+        writer->offsets = offsets;
+        writer->capacity *= 2;
+    }
+
+    if (writer->precision == 0.0)
+    {
+        // The arrays as they are
+        kind = TRAJECTORY_DOUBLE;
+        for (size_t k = 0; k < 3; k++)
+        {
+            memcpy(payload + size, coord[k], N * sizeof(double));
+            size += N * sizeof(double);
+        }
+    }
+    else
+    {
+        // Multiples of the precision, as differences from their prediction
+        size_t order = writer->n_frames % TRAJECTORY_KEY_INTERVAL;
+        kind = (order == 0) ? TRAJECTORY_KEY : TRAJECTORY_DELTA;
+        for (size_t k = 0; k < 3; k++)
+        {
+            int64_t* previous = writer->previous + k * N;
+            int64_t* before = writer->before + k * N;
+            for (size_t i = 0; i < N; i++)
+            {
+                int64_t q = llround(coord[k][i] / writer->precision);
+                int64_t prediction = (order == 0) ? 0 : (order == 1) ? previous[i] : 2 * previous[i] - before[i];
+                size += put_varint(payload + size, zigzag(q - prediction));
+                before[i] = previous[i];
+                previous[i] = q;
+            }
+        }
+    }
+
+    uint32_t size32 = (uint32_t) size;
+    unsigned char* head = writer->buffer;
+    memcpy(head, &size32, sizeof(uint32_t));
+    memcpy(head + 4, &kind, sizeof(uint32_t));
+    memcpy(head + 8, &frame->step, sizeof(uint64_t));
+    memcpy(head + 16, &frame->kinetic, sizeof(double));
+    memcpy(head + 24, &frame->potential, sizeof(double));
+    memcpy(head + 32, &frame->total, sizeof(double));
+
+    if (fwrite(writer->buffer, 1, TRAJECTORY_FRAME_HEAD + size, writer->file) != TRAJECTORY_FRAME_HEAD + size) return -1;
+    writer->offsets[writer->n_frames++] = writer->position;
+    writer->position += TRAJECTORY_FRAME_HEAD + size;
+    return 0;
+}
+
+int trajectory_close_write(trajectory_writer_t* writer)
+{
+    if (writer == NULL) return 0;
+
+    // Index of the frames at the end of the file
+    uint64_t n_frames = writer->n_frames, index = writer->position;
+    fwrite(writer->offsets, sizeof(uint64_t), writer->n_frames, writer->file);
+    fwrite(&n_frames, sizeof(n_frames), 1, writer->file);
+    fwrite(&index, sizeof(index), 1, writer->file);
+    fwrite(trajectory_index_magic, 1, sizeof(trajectory_index_magic), writer->file);
+
+    int status = ferror(writer->file) ? -1 : 0;
+    if (fclose(writer->file) != 0) status = -1;
+    free(writer->offsets);
+    free(writer->previous);
+    free(writer->before);
+    free(writer->buffer);
+    free(writer);
+    return status;
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                              TO READ A BINARY TRAJECTORY                                     //
+// ---------------------------------------------------------------------------------------------//
+
+// Offsets of the frames of a file without index, following the frames from the first one;
+// a last frame cut short is left out
+static void trajectory_scan(trajectory_reader_t* reader, long first, long file_size)
+{
+    size_t capacity = 1024;
+    long position = first;
+    reader->offsets = malloc(capacity * sizeof(uint64_t));
+    if (reader->offsets == NULL) error_memory_allocation("trajectory index");
+    reader->n_frames = 0;
+
+    while (position + (long) TRAJECTORY_FRAME_HEAD <= file_size)
+    {
+        uint32_t size;
+        if (fseek(reader->file, position, SEEK_SET) != 0 || fread(&size, sizeof(size), 1, reader->file) != 1) break;
+        if (position + (long) TRAJECTORY_FRAME_HEAD + (long) size > file_size) break;
+
+        if (reader->n_frames == capacity)
+        {
+            uint64_t* offsets = realloc(reader->offsets, 2 * capacity * sizeof(uint64_t));
+            if (offsets == NULL) error_memory_allocation("trajectory index");
+            reader->offsets = offsets;
+            capacity *= 2;
+        }
+        reader->offsets[reader->n_frames++] = position;
+        position += TRAJECTORY_FRAME_HEAD + size;
+    }
+}
+
+trajectory_reader_t* trajectory_open_read(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) return NULL;
+
+    char magic[8];
+    uint64_t Natoms, interval;
+    double precision;
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, trajectory_magic, sizeof(magic)) != 0 ||
+        fread(&Natoms, sizeof(Natoms), 1, file) != 1 || fread(&precision, sizeof(precision), 1, file) != 1 ||
+        fread(&interval, sizeof(interval), 1, file) != 1 || interval == 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    // The symbols must fit in the file: this bounds Natoms, and all the sizes computed from it,
+    // before anything is allocated
+    long header = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    if (Natoms == 0 || header < 0 || file_size < header || Natoms > (uint64_t) (file_size - header) / TRAJECTORY_SYMBOL ||
+        fseek(file, header, SEEK_SET) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    trajectory_reader_t* reader = calloc(1, sizeof(trajectory_reader_t));
+    if (reader == NULL) error_memory_allocation("trajectory reader");
+    reader->file = file;
+    reader->Natoms = Natoms;
+    reader->precision = precision;
+    reader->key_interval = interval;
+    reader->symbols = malloc(Natoms * sizeof(char*));
+    char* symbols = malloc(Natoms * (TRAJECTORY_SYMBOL + 1));
+    reader->current = calloc(3 * Natoms, sizeof(int64_t));
+    reader->previous = calloc(3 * Natoms, sizeof(int64_t));
+    reader->buffer = malloc(TRAJECTORY_FRAME_HEAD + TRAJECTORY_MAX_PAYLOAD(Natoms));
+    if (reader->symbols == NULL || symbols == NULL || reader->current == NULL || reader->previous == NULL || reader->buffer == NULL)
+        error_memory_allocation("trajectory reader");
+
+    for (size_t i = 0; i < Natoms; i++)
+    {
+        reader->symbols[i] = symbols + i * (TRAJECTORY_SYMBOL + 1);
+        if (fread(reader->symbols[i], 1, TRAJECTORY_SYMBOL, file) != TRAJECTORY_SYMBOL)
+        {
+            trajectory_close_read(reader);
+            return NULL;
+        }
+        reader->symbols[i][TRAJECTORY_SYMBOL] = '\0';
+    }
+    long first = ftell(file);
+
+    // The index at the end, or the frames one after the other when it is missing
+    uint64_t n_frames = 0, index = 0;
+    int indexed = 0;
+    if (file_size >= first + 24 && fseek(file, file_size - 24, SEEK_SET) == 0 && fread(&n_frames, sizeof(n_frames), 1, file) == 1 &&
+        fread(&index, sizeof(index), 1, file) == 1 && fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+        memcmp(magic, trajectory_index_magic, sizeof(magic)) == 0 && index >= (uint64_t) first &&
+        n_frames <= (uint64_t) (file_size - 24 - first) / 8 && index + 8 * n_frames + 24 == (uint64_t) file_size)
+    {
+        reader->offsets = malloc((n_frames + 1) * sizeof(uint64_t));
+        if (reader->offsets == NULL) error_memory_allocation("trajectory index");
+        indexed = fseek(file, (long) index, SEEK_SET) == 0 && fread(reader->offsets, sizeof(uint64_t), n_frames, file) == n_frames;
+        reader->n_frames = n_frames;
+    }
+    if (!indexed)
+    {
+        free(reader->offsets);
+        trajectory_scan(reader, first, file_size);
+    }
+
+    reader->current_frame = reader->n_frames;
+    return reader;
+}
+
+// Reads frame k into the buffer and its energies into frame, returning its kind (-1 on error)
+static int trajectory_load(trajectory_reader_t* reader, size_t k, size_t* size, trajectory_frame_t* frame)
+{
+    unsigned char* head = reader->buffer;
+    uint32_t size32, kind;
+
+    if (fseek(reader->file, (long) reader->offsets[k], SEEK_SET) != 0 ||
+        fread(head, 1, TRAJECTORY_FRAME_HEAD, reader->file) != TRAJECTORY_FRAME_HEAD) return -1;
+    memcpy(&size32, head, sizeof(uint32_t));
+    memcpy(&kind, head + 4, sizeof(uint32_t));
+    if (size32 > TRAJECTORY_MAX_PAYLOAD(reader->Natoms) ||
+        fread(head + TRAJECTORY_FRAME_HEAD, 1, size32, reader->file) != size32) return -1;
+
+    if (frame != NULL)
+    {
+        memcpy(&frame->step, head + 8, sizeof(uint64_t));
+        memcpy(&frame->kinetic, head + 16, sizeof(double));
+        memcpy(&frame->potential, head + 24, sizeof(double));
+        memcpy(&frame->total, head + 32, sizeof(double));
+    }
+    *size = size32;
+    return (int) kind;
+}
+
+int trajectory_read_frame(trajectory_reader_t* reader, size_t k, double* x, double* y, double* z, trajectory_frame_t* frame)
+{
+    size_t N = reader->Natoms, size;
+    double* coord[3] = {x, y, z};
+    const unsigned char* payload = reader->buffer + TRAJECTORY_FRAME_HEAD;
+    if (k >= reader->n_frames) return -1;
+
+    if (reader->precision == 0.0)
+    {
+        if (trajectory_load(reader, k, &size, frame) != TRAJECTORY_DOUBLE || size != 3 * N * sizeof(double)) return -1;
+        for (size_t c = 0; c < 3; c++) memcpy(coord[c], payload + c * N * sizeof(double), N * sizeof(double));
+        return 0;
+    }
+
+    // Decode from the key frame of k, or from the frame after the last one decoded when it lies in between
+    size_t key = k - k % reader->key_interval;
+    size_t from = key;
+    if (reader->current_frame < reader->n_frames && reader->current_frame >= key && reader->current_frame < k)
+        from = reader->current_frame + 1;
+    if (reader->current_frame == k)
+    {
+        if (trajectory_load(reader, k, &size, frame) < 0) return -1;
+        from = k + 1;
+    }
+
+    for (size_t j = from; j <= k; j++)
+    {
+        int kind = trajectory_load(reader, j, &size, frame);
+        if (kind != ((j == key) ? TRAJECTORY_KEY : TRAJECTORY_DELTA))
+        {
+            reader->current_frame = reader->n_frames;
+            return -1;
+        }
+
+        const unsigned char* p = payload;
+        const unsigned char* end = payload + size;
+        for (size_t i = 0; i < 3 * N; i++)
+        {
+            uint64_t u;
+            size_t n = get_varint(p, end, &u);
+            if (n == 0)
+            {
+                reader->current_frame = reader->n_frames;
+                return -1;
+            }
+            p += n;
+            int64_t prediction = (j == key) ? 0 : (j == key + 1) ? reader->current[i] : 2 * reader->current[i] - reader->previous[i];
+            reader->previous[i] = reader->current[i];
+            reader->current[i] = prediction + unzigzag(u);
+        }
+        reader->current_frame = j;
+    }
+
+    for (size_t c = 0; c < 3; c++)
+        for (size_t i = 0; i < N; i++)
+            coord[c][i] = reader->current[c * N + i] * reader->precision;
+    return 0;
+}
+
+void trajectory_close_read(trajectory_reader_t* reader)
+{
+    if (reader == NULL) return;
+    fclose(reader->file);
+    if (reader->symbols != NULL) free(reader->symbols[0]);
+    free(reader->symbols);
+    free(reader->offsets);
+    free(reader->current);
+    free(reader->previous);
+    free(reader->buffer);
+    free(reader);
+}
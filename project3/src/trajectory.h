@@ -0,0 +1,87 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "particles.h"
+
+// Binary trajectory (.trj), in the byte order of the machine that wrote it:
+//     header:  "MDTRJ01\n", Natoms (uint64), precision (double), key frame interval (uint64),
+//              the symbols of the atoms (TRAJECTORY_SYMBOL bytes each, NUL padded)
+//     frames:  payload size (uint32), kind (uint32), step (uint64), kinetic, potential and total
+//              energies (double), then the payload: the x, y and z arrays
+//     index:   offset of each frame (uint64), number of frames (uint64), offset of the index
+//              (uint64), "MDTRJIDX"
+// With a precision of 0 the coordinates are stored as doubles, so that writing a frame is a copy
+// of the arrays. Otherwise they are rounded to multiples of the precision, and each one is stored
+// as its difference from a prediction, zigzag and varint encoded: zero in the key frames, the
+// previous frame in the one after, and the linear extrapolation 2 q[k-1] - q[k-2] of the two
+// previous frames in the others. Atoms move smoothly, so that most differences take one byte
+// per coordinate. The key frames and the index give random access; a file without its index
+// (interrupted run) is read by following the frames from the start.
+#define TRAJECTORY_SYMBOL 8             // Bytes per symbol
+#define TRAJECTORY_KEY_INTERVAL 100     // One key frame every TRAJECTORY_KEY_INTERVAL frames
+
+#define TRAJECTORY_DOUBLE 0             // Kinds of frames: coordinates in double precision
+#define TRAJECTORY_KEY    1             // Quantized coordinates
+#define TRAJECTORY_DELTA  2             // Quantized differences from the prediction of the previous frames
+
+// Energies of a frame
+typedef struct
+{
+    uint64_t step;
+    double kinetic;
+    double potential;
+    double total;
+} trajectory_frame_t;
+
+typedef struct
+{
+    FILE* file;
+    size_t Natoms;
+    double precision;       // Quantization step of the coordinates (0: doubles)
+    uint64_t* offsets;      // Offset of each frame written
+    size_t n_frames;        // Number of frames written
+    size_t capacity;        // Number of offsets allocated
+    uint64_t position;      // Bytes written so far
+    int64_t* previous;      // Quantized coordinates of the previous frame (3 Natoms)
+    int64_t* before;        // And of the frame before it
+    unsigned char* buffer;  // Frame being encoded
+} trajectory_writer_t;
+
+typedef struct
+{
+    FILE* file;
+    size_t Natoms;
+    double precision;       // Quantization step of the coordinates (0: doubles)
+    uint64_t key_interval;  // Frames between two key frames
+    char** symbols;         // Symbols of the atoms
+    uint64_t* offsets;      // Offset of each frame
+    size_t n_frames;        // Number of frames
+    int64_t* current;       // Quantized coordinates of the last frame decoded (3 Natoms)
+    size_t current_frame;   // Index of that frame (n_frames: none)
+    int64_t* previous;      // Quantized coordinates of the frame before it
+    unsigned char* buffer;  // Frame being decoded
+} trajectory_reader_t;
+
+// Function to create a binary trajectory of Natoms atoms with their symbols, with coordinates
+// quantized to multiples of precision (0: doubles). Returns NULL if the file cannot be created.
+trajectory_writer_t* trajectory_open_write(const char* filename, size_t Natoms, char** symbols, double precision);
+
+// Function to append the coordinates of the particles and the energies of a step. Returns 0 on success.
+int trajectory_write_frame(trajectory_writer_t* writer, const particles_t* particles, const trajectory_frame_t* frame);
+
+// Function to write the frame index and close the trajectory. Returns 0 on success.
+int trajectory_close_write(trajectory_writer_t* writer);
+
+// Function to open a binary trajectory and read its index. Returns NULL if it is not one.
+trajectory_reader_t* trajectory_open_read(const char* filename);
+
+// Function to read frame number k into x, y, z (Natoms each) and frame. Returns 0 on success.
+int trajectory_read_frame(trajectory_reader_t* reader, size_t k, double* x, double* y, double* z, trajectory_frame_t* frame);
+
+// Function to close a trajectory opened for reading
+void trajectory_close_read(trajectory_reader_t* reader);
+
+#endif
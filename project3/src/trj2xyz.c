@@ -0,0 +1,75 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include "utils.h"
+#include "particles.h"
+#include "trajectory.h"
+
+// --------------------------------------------------------------------------------------------- //
+// ****************************** BINARY TRAJECTORY TO XYZ ************************************* //
+// --------------------------------------------------------------------------------------------- //
+
+// Usage: ./trj2xyz [-b first] [-e last] [-s stride] input.trj [output.xyz]
+// Writes the frames first, first + stride, ... up to last (all of them by default) of a binary
+// trajectory of dynamics -b or -q in the XYZ format of dynamics, to output.xyz or the standard output.
+// The frames are found through the index of the file, so a range near the end is read directly.
+int main(int argc, char** argv)
+{
+    size_t first = 0, last = (size_t) -1, stride = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:e:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': first = (size_t) atol(optarg); break;
+            case 'e': last = (size_t) atol(optarg); break;
+            case 's': stride = (size_t) atol(optarg); break;
+            default:
+                printf("Usage: %s [-b first] [-e last] [-s stride] input.trj [output.xyz]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || stride == 0)
+    {
+        printf("Usage: %s [-b first] [-e last] [-s stride] input.trj [output.xyz]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    trajectory_reader_t* reader = trajectory_open_read(argv[optind]);
+    if (reader == NULL)
+    {
+        printf("Error: %s is not a binary trajectory\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* output = (optind + 1 < argc) ? fopen(argv[optind + 1], "w") : stdout;
+    if (output == NULL)
+    {
+        printf("Error opening %s\n", argv[optind + 1]);
+        trajectory_close_read(reader);
+        return EXIT_FAILURE;
+    }
+
+    // Frames are read into the coordinates of a set of particles, and written as dynamics does
+    particles_t* particles = particles_create(reader->Natoms);
+    trajectory_frame_t frame;
+    int status = 0;
+    if (last >= reader->n_frames) last = reader->n_frames - 1;
+    for (size_t k = first; reader->n_frames > 0 && k <= last; k += stride)
+    {
+        if (trajectory_read_frame(reader, k, particles->x, particles->y, particles->z, &frame) != 0)
+        {
+            fprintf(stderr, "Error: frame %zu of %s cannot be read\n", k, argv[optind]);
+            status = 1;
+            break;
+        }
+        write_trajectory(output, particles, reader->symbols, frame.kinetic, frame.potential, frame.total, frame.step);
+    }
+
+    if (output != stdout) fclose(output);
+    particles_free(particles);
+    trajectory_close_read(reader);
+    return status ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "utils.h"
+#include "writer.h"
+
+// ---------------------------------------------------------------------------------------------//
+//                                  THE WRITER THREAD                                           //
+// ---------------------------------------------------------------------------------------------//
+
+// Writes one snapshot to the trajectory. Returns 0 on success.
+static int async_writer_write(async_writer_t* writer, size_t slot)
+{
+    const particles_t* snapshot = &writer->slots[slot];
+    const trajectory_frame_t* frame = &writer->frames[slot];
+
+    if (writer->binary != NULL) return trajectory_write_frame(writer->binary, snapshot, frame);
+    write_trajectory(writer->text, snapshot, writer->symbols, frame->kinetic, frame->potential, frame->total, frame->step);
+    return ferror(writer->text) ? -1 : 0;
+}
+
+// Takes the oldest snapshot of the queue, writes it without holding the lock and frees its slot,
+// until the writer is closed and the queue is empty. After an error the snapshots are only freed.
+static void* async_writer_run(void* arg)
+{
+    async_writer_t* writer = arg;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;)
+    {
+        while (writer->n_queued == 0 && !writer->closing) pthread_cond_wait(&writer->queued, &writer->lock);
+        if (writer->n_queued == 0) break;
+
+        size_t slot = writer->queue[writer->queue_head];
+        writer->queue_head = (writer->queue_head + 1) % writer->n_slots;
+        writer->n_queued--;
+        int error = writer->error;
+        pthread_mutex_unlock(&writer->lock);
+
+        int status = error ? 0 : async_writer_write(writer, slot);
+
+        pthread_mutex_lock(&writer->lock);
+        if (status != 0) writer->error = 1;
+        else if (!error) writer->n_written++;
+        writer->free_slots[writer->n_free++] = slot;
+        pthread_cond_signal(&writer->freed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------//
+//                          TO START, FEED AND STOP THE WRITER                                  //
+// ---------------------------------------------------------------------------------------------//
+
+async_writer_t* async_writer_create(size_t Natoms, size_t n_slots, writer_policy_t policy, FILE* text, char** symbols, trajectory_writer_t* binary)
+{
+    async_writer_t* writer = calloc(1, sizeof(async_writer_t));
+    if (writer == NULL) error_memory_allocation("trajectory writer");
+    if (n_slots < 2) n_slots = 2;
+
+    writer->Natoms = Natoms;
+    writer->policy = policy;
+    writer->n_slots = n_slots;
+    writer->text = text;
+    writer->symbols = symbols;
+    writer->binary = binary;
+
+    // The coordinates of all the snapshots in one block, each array padded as those of the particles
+    size_t padded = particles_padded(Natoms);
+    writer->block = aligned_alloc(PARTICLES_ALIGN, n_slots * 3 * padded * sizeof(double));
+    writer->slots = calloc(n_slots, sizeof(particles_t));
+    writer->frames = calloc(n_slots, sizeof(trajectory_frame_t));
+    writer->queue = malloc(n_slots * sizeof(size_t));
+    writer->free_slots = malloc(n_slots * sizeof(size_t));
+    if (writer->block == NULL || writer->slots == NULL || writer->frames == NULL || writer->queue == NULL || writer->free_slots == NULL)
+        error_memory_allocation("trajectory writer");
+    memset(writer->block, 0, n_slots * 3 * padded * sizeof(double));
+
+    for (size_t s = 0; s < n_slots; s++)
+    {
+        double* a = (double*) writer->block + s * 3 * padded;
+        writer->slots[s].Natoms = Natoms;
+        writer->slots[s].padded = padded;
+        writer->slots[s].x = a;
+        writer->slots[s].y = a + padded;
+        writer->slots[s].z = a + 2 * padded;
+        writer->free_slots[s] = n_slots - 1 - s;
+    }
+    writer->n_free = n_slots;
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->queued, NULL);
+    pthread_cond_init(&writer->freed, NULL);
+    if (pthread_create(&writer->thread, NULL, async_writer_run, writer) != 0)
+    {
+        writer->closing = 1;    // No thread to join
+        async_writer_free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int async_writer_push(async_writer_t* writer, const particles_t* particles, const trajectory_frame_t* frame)
+{
+    int dropped = 0;
+
+    // A free slot, or what the policy says when there is none
+    pthread_mutex_lock(&writer->lock);
+    if (writer->error)
+    {
+        pthread_mutex_unlock(&writer->lock);
+        return -1;
+    }
+    if (writer->n_free == 0)
+    {
+        if (writer->policy == WRITER_DROP_NEWEST)
+        {
+            writer->n_dropped++;
+            pthread_mutex_unlock(&writer->lock);
+            return 1;
+        }
+        if (writer->policy == WRITER_DROP_OLDEST && writer->n_queued > 0)
+        {
+            writer->free_slots[writer->n_free++] = writer->queue[writer->queue_head];
+            writer->queue_head = (writer->queue_head + 1) % writer->n_slots;
+            writer->n_queued--;
+            writer->n_dropped++;
+            dropped = 1;
+        }
+        else
+        {
+            writer->n_waits++;
+            while (writer->n_free == 0 && !writer->error) pthread_cond_wait(&writer->freed, &writer->lock);
+            if (writer->error)
+            {
+                pthread_mutex_unlock(&writer->lock);
+                return -1;
+            }
+        }
+    }
+    size_t slot = writer->free_slots[--writer->n_free];
+    pthread_mutex_unlock(&writer->lock);
+
+    // The copy is done while the thread writes the other slots
+    particles_t* snapshot = &writer->slots[slot];
+    memcpy(snapshot->x, particles->x, writer->Natoms * sizeof(double));
+    memcpy(snapshot->y, particles->y, writer->Natoms * sizeof(double));
+    memcpy(snapshot->z, particles->z, writer->Natoms * sizeof(double));
+    writer->frames[slot] = *frame;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->queue[(writer->queue_head + writer->n_queued) % writer->n_slots] = slot;
+    writer->n_queued++;
+    pthread_cond_signal(&writer->queued);
+    pthread_mutex_unlock(&writer->lock);
+
+    return dropped;
+}
+
+int async_writer_close(async_writer_t* writer)
+{
+    if (writer->closing) return writer->error ? -1 : 0;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->closing = 1;
+    pthread_cond_signal(&writer->queued);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    return writer->error ? -1 : 0;
+}
+
+void async_writer_free(async_writer_t* writer)
+{
+    if (writer == NULL) return;
+    async_writer_close(writer);
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->queued);
+    pthread_cond_destroy(&writer->freed);
+    free(writer->block);
+    free(writer->slots);
+    free(writer->frames);
+    free(writer->queue);
+    free(writer->free_slots);
+    free(writer);
+}
@@ -0,0 +1,64 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "particles.h"
+#include "trajectory.h"
+
+// Background writer of the trajectory: the integration loop copies the positions and energies of
+// a step into a free slot of a ring of preallocated snapshots and goes on, while a thread writes
+// the queued snapshots, in order, to the XYZ or binary trajectory. When all the slots are taken
+// (the disk is slower than the steps), the policy decides what happens to the new snapshot.
+typedef enum
+{
+    WRITER_BLOCK,           // Wait for a slot: every frame is written, the steps slow down to the disk
+    WRITER_DROP_NEWEST,     // Drop the new snapshot: the steps never wait
+    WRITER_DROP_OLDEST      // Drop the oldest snapshot not being written, to keep the most recent ones
+} writer_policy_t;
+
+typedef struct
+{
+    size_t Natoms;
+    writer_policy_t policy;
+    size_t n_slots;             // Number of snapshots of the ring
+    particles_t* slots;         // Snapshots: only Natoms, padded, x, y and z are set
+    trajectory_frame_t* frames; // Step and energies of each snapshot
+    void* block;                // Memory of the coordinates of the snapshots
+    size_t* queue;              // Slots waiting to be written, oldest first (a ring of n_slots)
+    size_t queue_head;          // Position of the oldest in queue
+    size_t n_queued;            // Number of slots waiting
+    size_t* free_slots;         // Stack of the free slots
+    size_t n_free;              // Number of free slots
+    FILE* text;                 // XYZ trajectory, or NULL
+    char** symbols;             // Symbols of the atoms, for the XYZ trajectory
+    trajectory_writer_t* binary;// Binary trajectory, or NULL
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;      // Signaled when a slot is queued or the writer is closed
+    pthread_cond_t freed;       // Signaled when a slot is written
+    int closing;                // No more snapshots: the thread writes the queue and exits
+    int error;                  // A frame could not be written
+    size_t n_written;           // Number of frames written
+    size_t n_dropped;           // Number of snapshots dropped
+    size_t n_waits;             // Number of snapshots that waited for a slot
+} async_writer_t;
+
+// Function to start the writer thread of Natoms atoms with n_slots (at least 2) snapshots, writing
+// to the XYZ file text with symbols, or to the binary trajectory when binary is not NULL. The
+// files stay open after async_writer_free. Returns NULL if the thread cannot be started.
+async_writer_t* async_writer_create(size_t Natoms, size_t n_slots, writer_policy_t policy, FILE* text, char** symbols, trajectory_writer_t* binary);
+
+// Function to queue the positions of the particles and the energies of a step. Returns 0 if queued,
+// 1 if a snapshot was dropped and -1 if the writer failed to write a frame.
+int async_writer_push(async_writer_t* writer, const particles_t* particles, const trajectory_frame_t* frame);
+
+// Function to write the queued snapshots and stop the thread; the counts of the writer are then
+// final. Returns 0 if every frame queued was written.
+int async_writer_close(async_writer_t* writer);
+
+// Function to free a writer (closed first if it is not)
+void async_writer_free(async_writer_t* writer);
+
+#endif